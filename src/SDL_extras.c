@@ -37,6 +37,12 @@ enum
 };
 
 #include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifndef WIN32
+#include <unistd.h>
+#endif
 
 #include "convert_utf.h"
 #include "SDL_extras.h"
@@ -184,199 +190,409 @@ void RoundCorners(SDL_Surface* s, Uint16 radius)
      if y is a nonzero value, then flip vertically
 
      note: you can have it flip both
+
+   The copy has the same pixel format as the input and keeps its
+   colorkey and alpha settings. Pixels are moved directly rather than
+   with one blit per column or row.
 **********************/
-SDL_Surface* Flip( SDL_Surface *in, int x, int y ) {
-        SDL_Surface *out, *tmp;
-        SDL_Rect from_rect, to_rect;
-        Uint32        flags;
-        Uint32  colorkey=0;
+/* Copy 'w' pixels of 'bpp' bytes from 'src' to 'dst' in reverse order: */
+static void mirror_row(Uint8* dst, const Uint8* src, int w, int bpp)
+{
+  int i = 0;
 
-        /* --- grab the settings for the incoming pixmap --- */
+  switch (bpp)
+  {
+    case 1:
+      for (; i < w; i++)
+        dst[i] = src[w - 1 - i];
+      break;
 
-        SDL_LockSurface(in);
-        flags = in->flags;
+    case 2:
+    {
+      Uint16* d = (Uint16*)dst;
+      const Uint16* s = (const Uint16*)src;
+      for (; i < w; i++)
+        d[i] = s[w - 1 - i];
+      break;
+    }
 
-        /* --- change in's flags so ignore colorkey & alpha --- */
+    case 3:
+      for (; i < w; i++)
+      {
+        const Uint8* s = src + (w - 1 - i) * 3;
+        dst[i * 3] = s[0];
+        dst[i * 3 + 1] = s[1];
+        dst[i * 3 + 2] = s[2];
+      }
+      break;
 
-        if (flags & SDL_SRCCOLORKEY) {
-                in->flags &= ~SDL_SRCCOLORKEY;
-                colorkey = in->format->colorkey;
-        }
-        if (flags & SDL_SRCALPHA) {
-                in->flags &= ~SDL_SRCALPHA;
-        }
+    case 4:
+    {
+      Uint32* d = (Uint32*)dst;
+      const Uint32* s = (const Uint32*)src;
+#ifdef __SSE2__
+      /* Four pixels at a time, reversed within the register: */
+      for (; i + 4 <= w; i += 4)
+      {
+        __m128i v = _mm_loadu_si128((const __m128i*)(s + w - 4 - i));
+        _mm_storeu_si128((__m128i*)(d + i), _mm_shuffle_epi32(v, 0x1B));
+      }
+#endif
+      for (; i < w; i++)
+        d[i] = s[w - 1 - i];
+      break;
+    }
+  }
+}
 
-        SDL_UnlockSurface(in);
 
-        /* --- create our new surface --- */
+SDL_Surface* Flip( SDL_Surface *in, int x, int y ) {
+        SDL_Surface *out;
+        SDL_PixelFormat *fmt;
+        int row_bytes, j;
 
-        out = SDL_CreateRGBSurface(
-                SDL_SWSURFACE,
-                in->w, in->h, 32, rmask, gmask, bmask, amask);
-
-        /* --- flip horizontally if requested --- */
-
-        if (x) {
-                from_rect.h = to_rect.h = in->h;
-                from_rect.w = to_rect.w = 1;
-                from_rect.y = to_rect.y = 0;
-                from_rect.x = 0;
-                to_rect.x = in->w - 1;
-
-                do {
-                        SDL_BlitSurface(in, &from_rect, out, &to_rect);
-                        from_rect.x++;
-                        to_rect.x--;
-                } while (to_rect.x >= 0);
-        }
+        if (!in)
+                return NULL;
 
-        /* --- flip vertically if requested --- */
+        fmt = in->format;
 
-        if (y) {
-                from_rect.h = to_rect.h = 1;
-                from_rect.w = to_rect.w = in->w;
-                from_rect.x = to_rect.x = 0;
-                from_rect.y = 0;
-                to_rect.y = in->h - 1;
+        /* --- create our new surface, in the same format as 'in' --- */
 
-                do {
-                        SDL_BlitSurface(in, &from_rect, out, &to_rect);
-                        from_rect.y++;
-                        to_rect.y--;
-                } while (to_rect.y >= 0);
+        out = SDL_CreateRGBSurface(
+                SDL_SWSURFACE, in->w, in->h, fmt->BitsPerPixel,
+                fmt->Rmask, fmt->Gmask, fmt->Bmask, fmt->Amask);
+        if (!out)
+        {
+                fprintf(stderr, "Flip() - could not create surface: %s\n",
+                        SDL_GetError());
+                return NULL;
         }
 
-        /* --- restore colorkey & alpha on in and setup out the same --- */
+        if (fmt->palette)
+                SDL_SetColors(out, fmt->palette->colors, 0, fmt->palette->ncolors);
+
+        /* --- copy the pixels, reversing rows and/or columns --- */
+
+        row_bytes = in->w * fmt->BytesPerPixel;
 
         SDL_LockSurface(in);
+        SDL_LockSurface(out);
 
-        if (flags & SDL_SRCCOLORKEY) {
-                in->flags |= SDL_SRCCOLORKEY;
-                in->format->colorkey = colorkey;
-                tmp = SDL_DisplayFormat(out);
-                SDL_FreeSurface(out);
-                out = tmp;
-                out->flags |= SDL_SRCCOLORKEY;
-                out->format->colorkey = colorkey;
-        } else if (flags & SDL_SRCALPHA) {
-                in->flags |= SDL_SRCALPHA;
-                tmp = SDL_DisplayFormatAlpha(out);
-                SDL_FreeSurface(out);
-                out = tmp;
-        } else {
-                tmp = SDL_DisplayFormat(out);
-                SDL_FreeSurface(out);
-                out = tmp;
+        for (j = 0; j < in->h; j++)
+        {
+                Uint8* src_row = (Uint8*)in->pixels + (y ? in->h - 1 - j : j) * in->pitch;
+                Uint8* dst_row = (Uint8*)out->pixels + j * out->pitch;
+
+                if (x)
+                        mirror_row(dst_row, src_row, in->w, fmt->BytesPerPixel);
+                else
+                        memcpy(dst_row, src_row, row_bytes);
         }
 
+        SDL_UnlockSurface(out);
         SDL_UnlockSurface(in);
 
+        /* --- set out up with the same colorkey & alpha as in --- */
+
+        SDL_SetColorKey(out, in->flags & (SDL_SRCCOLORKEY | SDL_RLEACCEL),
+                        fmt->colorkey);
+        SDL_SetAlpha(out, in->flags & SDL_SRCALPHA, fmt->alpha);
+
         return out;
 }
 
-/* Blend two surfaces together. The third argument is between 0.0 and
-   1.0, and represents the weight assigned to the first surface.  If
-   the pointer to the second surface is NULL, this performs fading.
-
-   Currently this works only with RGBA images, but this is largely to
-   make the (fast) pointer arithmetic work out; it could be easily
-   generalized to other image types. */
-SDL_Surface* Blend(SDL_Surface* S1, SDL_Surface* S2, float gamma)
+/* BlitOntoAlpha() composites 'src' over 'dst' at (x, y), like           */
+/* SDL_BlitSurface(), except that the alpha channel of 'dst' is updated   */
+/* too. (An RGBA->RGBA blit in SDL leaves the destination alpha alone, so */
+/* it can't be used to build up a transparent image from pieces.)         */
+/* Both surfaces must be 32 bpp with an alpha channel.                    */
+/* Returns 1 on success, 0 on failure:                                    */
+int BlitOntoAlpha(SDL_Surface* src, SDL_Surface* dst, int x, int y)
 {
-  SDL_PixelFormat *fmt1, *fmt2;
-  Uint8 r1, r2, g1, g2, b1, b2, a1, a2;
-  SDL_Surface *tmpS, *ret;
-  Uint32 *cpix1, *epix1, *cpix2, *epix2;
-  float gamflip;
+  SDL_PixelFormat* sf;
+  SDL_PixelFormat* df;
+  int sx0 = 0, sy0 = 0, w, h;
+  int i, j;
 
-  if (!S1)
-    return NULL;
-
-  fmt1 = fmt2 = NULL;
-  tmpS = ret = NULL;
+  if (!src || !dst)
+    return 0;
 
-  gamflip = 1.0 - gamma;
-  if (gamma < 0 || gamflip < 0)
+  sf = src->format;
+  df = dst->format;
+  if (sf->BytesPerPixel != 4 || df->BytesPerPixel != 4
+   || !sf->Amask || !df->Amask)
   {
-    perror("gamma must be between 0 and 1");
-    exit(0);
+    fprintf(stderr, "BlitOntoAlpha() - both surfaces must be 32 bpp RGBA\n");
+    return 0;
   }
 
-  fmt1 = S1->format;
-
-  if (fmt1 && fmt1->BitsPerPixel != 32)
+  /* Clip to destination: */
+  w = src->w;
+  h = src->h;
+  if (x < 0)
   {
-    perror("This works only with RGBA images");
-    return S1;
+    sx0 = -x;
+    w += x;
+    x = 0;
   }
-  if (S2 != NULL)
+  if (y < 0)
   {
-    fmt2 = S2->format;
-    if (fmt2->BitsPerPixel != 32)
-    {
-      perror("This works only with RGBA images");
-      return S1;
-    }
-    // Check that both images have the same width dimension
-    if (S1->w != S2->w)
+    sy0 = -y;
+    h += y;
+    y = 0;
+  }
+  if (x + w > dst->w)
+    w = dst->w - x;
+  if (y + h > dst->h)
+    h = dst->h - y;
+  if (w <= 0 || h <= 0)
+    return 1;
+
+  SDL_LockSurface(src);
+  SDL_LockSurface(dst);
+
+  for (j = 0; j < h; j++)
+  {
+    Uint32* sp = (Uint32*)((Uint8*)src->pixels + (sy0 + j) * src->pitch) + sx0;
+    Uint32* dp = (Uint32*)((Uint8*)dst->pixels + (y + j) * dst->pitch) + x;
+
+    for (i = 0; i < w; i++, sp++, dp++)
     {
-      printf("S1->w %d, S2->w %d;  S1->h %d, S2->h %d\n",
-             S1->w, S2->w, S1->h, S2->h);
-      printf("Both images must have the same width dimensions\n");
-      return S1;
+      Uint32 sa = (*sp & sf->Amask) >> sf->Ashift;
+      Uint32 da, oa, k;
+      Uint32 sr, sg, sb, dr, dg, db;
+
+      if (sa == 0)
+        continue;
+
+      sr = (*sp & sf->Rmask) >> sf->Rshift;
+      sg = (*sp & sf->Gmask) >> sf->Gshift;
+      sb = (*sp & sf->Bmask) >> sf->Bshift;
+      da = (*dp & df->Amask) >> df->Ashift;
+
+      if (sa < 255 && da > 0)
+      {
+        /* Standard "over" operator, in 0-255 integer arithmetic: */
+        dr = (*dp & df->Rmask) >> df->Rshift;
+        dg = (*dp & df->Gmask) >> df->Gshift;
+        db = (*dp & df->Bmask) >> df->Bshift;
+
+        k = da * (255 - sa) / 255;   /* dst weight after src covers it */
+        oa = sa + k;
+        sr = (sr * sa + dr * k) / oa;
+        sg = (sg * sa + dg * k) / oa;
+        sb = (sb * sa + db * k) / oa;
+        sa = oa;
+      }
+
+      *dp = (sr << df->Rshift) | (sg << df->Gshift)
+          | (sb << df->Bshift) | (sa << df->Ashift);
     }
   }
 
-  tmpS = SDL_ConvertSurface(S1, fmt1, SDL_SWSURFACE);
-  if (tmpS == NULL)
+  SDL_UnlockSurface(dst);
+  SDL_UnlockSurface(src);
+
+  return 1;
+}
+
+
+/* Blend two pixels byte by byte: (a * (256 - f) + b * f) >> 8, done on */
+/* two bytes at once in each half of a 32 bit word:                     */
+static inline Uint32 blend_pixel(Uint32 a, Uint32 b, Uint32 f)
+{
+  Uint32 nf = 256 - f;
+  Uint32 lo = (((a & 0x00ff00ff) * nf + (b & 0x00ff00ff) * f) >> 8) & 0x00ff00ff;
+  Uint32 hi = (((a >> 8) & 0x00ff00ff) * nf + ((b >> 8) & 0x00ff00ff) * f) & 0xff00ff00;
+  return lo | hi;
+}
+
+
+/* blend_pixel() over a row of 'n' pixels, 'f' from 0 to 256. 'dst' */
+/* may be the same as 'a' or 'b':                                    */
+static void blend_row32(Uint32* dst, const Uint32* a, const Uint32* b,
+                        int n, Uint32 f)
+{
+  int i = 0;
+
+#ifdef __SSE2__
+  __m128i zero = _mm_setzero_si128();
+  __m128i wa = _mm_set1_epi16(256 - f);
+  __m128i wb = _mm_set1_epi16(f);
+
+  for (; i + 4 <= n; i += 4)
   {
-    perror("SDL_ConvertSurface() failed");
-    return S1; 
+    __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+    __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+    __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), wa),
+                               _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), wb));
+    __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), wa),
+                               _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), wb));
+    lo = _mm_srli_epi16(lo, 8);
+    hi = _mm_srli_epi16(hi, 8);
+    _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
   }
-  if (-1 == SDL_LockSurface(tmpS))
+#endif
+  for (; i < n; i++)
+    dst[i] = blend_pixel(a[i], b[i], f);
+}
+
+
+/* Blend two surfaces together. The fourth argument is between 0.0 and
+   1.0, and represents the weight assigned to the first surface.  If
+   the pointer to the second surface is NULL, this performs fading
+   (of the alpha channel only).
+
+   BlendInto() writes the result into 'dst', which must be 32 bpp and
+   the same size as S1 - it may be S1 itself, to blend in place. S2 must
+   have the same width as S1; if the heights differ the images are
+   aligned at the bottom. All surfaces must be 32 bpp. When they also
+   share a pixel format (the usual case) whole rows are blended with
+   integer arithmetic; otherwise each pixel goes through SDL_GetRGBA().
+   Returns 1 on success, 0 on failure. */
+int BlendInto(SDL_Surface* dst, SDL_Surface* S1, SDL_Surface* S2, float gamma)
+{
+  SDL_PixelFormat *fmt1, *fmt2, *fmtd;
+  Uint32 f, nf;
+  int same_fmt, rows, k, i;
+
+  if (!dst || !S1)
+    return 0;
+
+  if (gamma < 0 || gamma > 1)
   {
-    perror("SDL_LockSurface() failed");
-    return S1; 
+    fprintf(stderr, "BlendInto() - gamma must be between 0 and 1, not %f\n",
+            gamma);
+    return 0;
   }
 
-  // We're going to go through the pixels in reverse order, to start
-  // from the bottom of each image. That way, we can blend things that
-  // are not of the same height and have them align at the bottom.
-  // So the "ending pixel" (epix) will be before the first pixel, and
-  // the current pixel (cpix) will be the last pixel.
-  epix1 = (Uint32*) tmpS->pixels - 1;
-  cpix1 = epix1 + tmpS->w * tmpS->h;
-  if (S2 != NULL
-      && (SDL_LockSurface(S2) != -1))
+  fmt1 = S1->format;
+  fmt2 = S2 ? S2->format : fmt1;
+  fmtd = dst->format;
+
+  if (fmt1->BitsPerPixel != 32 || fmt2->BitsPerPixel != 32
+   || fmtd->BitsPerPixel != 32)
   {
-    epix2 = (Uint32*) S2->pixels - 1;
-    cpix2 = epix2 + S2->w * S2->h;
+    fprintf(stderr, "BlendInto() - this works only with 32 bpp images\n");
+    return 0;
   }
-  else
+  if (dst->w != S1->w || dst->h != S1->h)
+  {
+    fprintf(stderr, "BlendInto() - 'dst' must be the same size as S1\n");
+    return 0;
+  }
+  // Check that both images have the same width dimension
+  if (S2 && S1->w != S2->w)
+  {
+    fprintf(stderr, "BlendInto() - both images must have the same width"
+                    " (S1 %dx%d, S2 %dx%d)\n", S1->w, S1->h, S2->w, S2->h);
+    return 0;
+  }
+
+  /* Weight of S1 in 256ths: */
+  f = (Uint32)(gamma * 256 + 0.5);
+  nf = 256 - f;
+
+  same_fmt = (fmt1->Rmask == fmtd->Rmask && fmt1->Gmask == fmtd->Gmask
+           && fmt1->Bmask == fmtd->Bmask && fmt1->Amask == fmtd->Amask
+           && fmt1->Rmask == fmt2->Rmask && fmt1->Gmask == fmt2->Gmask
+           && fmt1->Bmask == fmt2->Bmask && fmt1->Amask == fmt2->Amask);
+
+  if (-1 == SDL_LockSurface(S1))
+    return 0;
+  if (dst != S1 && -1 == SDL_LockSurface(dst))
   {
-    epix2 = epix1;
-    cpix2 = cpix1;
+    SDL_UnlockSurface(S1);
+    return 0;
+  }
+  if (S2 && S2 != S1 && S2 != dst && -1 == SDL_LockSurface(S2))
+  {
+    if (dst != S1)
+      SDL_UnlockSurface(dst);
+    SDL_UnlockSurface(S1);
+    return 0;
   }
 
-  for (; cpix1 > epix1; cpix1--, cpix2--)
+  /* Number of rows (counted from the bottom) covered by S2: */
+  rows = S2 ? (S2->h < S1->h ? S2->h : S1->h) : 0;
+
+  for (k = 0; k < S1->h; k++)
   {
-    SDL_GetRGBA(*cpix1, fmt1, &r1, &g1, &b1, &a1);
-    a1 = gamma * a1;
-    if (S2 != NULL && cpix2 > epix2)
+    int y1 = S1->h - 1 - k;
+    Uint32* p1 = (Uint32*)((Uint8*)S1->pixels + y1 * S1->pitch);
+    Uint32* pd = (Uint32*)((Uint8*)dst->pixels + y1 * dst->pitch);
+    Uint32* p2 = NULL;
+
+    if (k < rows)
+      p2 = (Uint32*)((Uint8*)S2->pixels + (S2->h - 1 - k) * S2->pitch);
+
+    if (same_fmt && p2)
     {
-      SDL_GetRGBA(*cpix2, fmt2, &r2, &g2, &b2, &a2);
-      r1 = gamma * r1 + gamflip * r2;
-      g1 = gamma * g1 + gamflip * g2;
-      b1 = gamma * b1 + gamflip * b2;
-      a1 += gamflip * a2;
+      /* Every channel, alpha included, is gamma * S1 + (1 - gamma) * S2: */
+      blend_row32(pd, p2, p1, S1->w, f);
     }
-    *cpix1 = SDL_MapRGBA(fmt1,r1,g1,b1,a1);
-  }
+    else if (same_fmt)
+    {
+      /* Fade: scale the alpha channel only: */
+      Uint32 am = fmt1->Amask;
+      Uint8 as = fmt1->Ashift;
+
+      for (i = 0; i < S1->w; i++)
+        pd[i] = (p1[i] & ~am) | (((((p1[i] & am) >> as) * f) >> 8) << as);
+    }
+    else
+    {
+      Uint8 r1, r2, g1, g2, b1, b2, a1, a2;
 
-  SDL_UnlockSurface(tmpS);
+      for (i = 0; i < S1->w; i++)
+      {
+        SDL_GetRGBA(p1[i], fmt1, &r1, &g1, &b1, &a1);
+        a1 = (a1 * f) >> 8;
+        if (p2)
+        {
+          SDL_GetRGBA(p2[i], fmt2, &r2, &g2, &b2, &a2);
+          r1 = (r1 * f + r2 * nf) >> 8;
+          g1 = (g1 * f + g2 * nf) >> 8;
+          b1 = (b1 * f + b2 * nf) >> 8;
+          a1 += (a2 * nf) >> 8;
+        }
+        pd[i] = SDL_MapRGBA(fmtd, r1, g1, b1, a1);
+      }
+    }
+  }
 
-  if (S2 != NULL)
+  if (S2 && S2 != S1 && S2 != dst)
     SDL_UnlockSurface(S2);
+  if (dst != S1)
+    SDL_UnlockSurface(dst);
+  SDL_UnlockSurface(S1);
+
+  return 1;
+}
+
+
+/* Like BlendInto(), but returns the result as a new surface in display */
+/* format, or NULL on failure:                                          */
+SDL_Surface* Blend(SDL_Surface* S1, SDL_Surface* S2, float gamma)
+{
+  SDL_Surface *tmpS, *ret;
+
+  if (!S1)
+    return NULL;
+
+  tmpS = SDL_ConvertSurface(S1, S1->format, SDL_SWSURFACE);
+  if (tmpS == NULL)
+  {
+    fprintf(stderr, "Blend() - SDL_ConvertSurface() failed: %s\n",
+            SDL_GetError());
+    return NULL;
+  }
+
+  if (!BlendInto(tmpS, tmpS, S2, gamma))
+  {
+    SDL_FreeSurface(tmpS);
+    return NULL;
+  }
 
   ret = SDL_DisplayFormatAlpha(tmpS);
   SDL_FreeSurface(tmpS);
@@ -401,35 +617,61 @@ int inRect( SDL_Rect r, int x, int y)
 /* Darkens the screen by a factor of 2^bits */
 void DarkenScreen(Uint8 bits)
 {
-#if BPP == 32
-  Uint32* p;
-#elif BPP == 16
-  Uint16* p;
-#else
-  return;
-#endif
-
   Uint32 rm = screen->format->Rmask;
   Uint32 gm = screen->format->Gmask;
   Uint32 bm = screen->format->Bmask;
+  Uint32 keep;
   int x, y;
 
   /* (realistically, 1 and 2 are the only useful values) */
   if (bits > 8)
     return;
 
-  p = screen->pixels;
+  /* Shifting the whole pixel and masking off the bits that crossed */
+  /* into a neighbouring channel is the same as shifting each one:  */
+  keep = ((rm >> bits) & rm) | ((gm >> bits) & gm) | ((bm >> bits) & bm);
+
+  if (-1 == SDL_LockSurface(screen))
+    return;
 
   for (y = 0; y < screen->h; y++)
   {
-    for (x = 0; x < screen->w; x++)
+    Uint8* row = (Uint8*)screen->pixels + y * screen->pitch;
+    x = 0;
+
+    if (screen->format->BytesPerPixel == 4)
     {
-      *p = (((*p&rm)>>bits)&rm)
-         | (((*p&gm)>>bits)&gm)
-         | (((*p&bm)>>bits)&bm);
-      p++;
+      Uint32* p = (Uint32*)row;
+#ifdef __SSE2__
+      __m128i m = _mm_set1_epi32(keep);
+      __m128i sh = _mm_cvtsi32_si128(bits);
+      for (; x + 4 <= screen->w; x += 4)
+      {
+        __m128i v = _mm_loadu_si128((__m128i*)(p + x));
+        _mm_storeu_si128((__m128i*)(p + x), _mm_and_si128(_mm_srl_epi32(v, sh), m));
+      }
+#endif
+      for (; x < screen->w; x++)
+        p[x] = (p[x] >> bits) & keep;
+    }
+    else if (screen->format->BytesPerPixel == 2)
+    {
+      Uint16* p = (Uint16*)row;
+#ifdef __SSE2__
+      __m128i m = _mm_set1_epi16(keep);
+      __m128i sh = _mm_cvtsi32_si128(bits);
+      for (; x + 8 <= screen->w; x += 8)
+      {
+        __m128i v = _mm_loadu_si128((__m128i*)(p + x));
+        _mm_storeu_si128((__m128i*)(p + x), _mm_and_si128(_mm_srl_epi16(v, sh), m));
+      }
+#endif
+      for (; x < screen->w; x++)
+        p[x] = (p[x] >> bits) & keep;
     }
   }
+
+  SDL_UnlockSurface(screen);
 }
 
 
@@ -438,6 +680,10 @@ void SwitchScreenMode(void)
   int window = (screen->flags & SDL_FULLSCREEN);
   SDL_Surface* oldscreen = screen;
 
+  /* A background being loaded in the background would be the wrong */
+  /* size, and uses the screen format - so get rid of it first:      */
+  CancelBkgdPrefetch();
+
   if (!window)
   {
     screen = SDL_SetVideoMode(fs_res_x,
@@ -468,6 +714,8 @@ void SwitchScreenMode(void)
   {
     SDL_FreeSurface(oldscreen);
     oldscreen = NULL;
+    /* Only keep the background for the mode we are now in: */
+    ReleaseInactiveBkgd();
     SDL_UpdateRect(screen, 0, 0, 0, 0);
   }
 
@@ -483,103 +731,508 @@ int WaitForKeypress(void)
         return evt.key.keysym.sym;
       else SDL_Delay(50);
 }
-/* Swiped shamelessly from TuxPaint
-   Based on code from: http://www.codeproject.com/cs/media/imageprocessing4.asp
-   copyright 2002 Christian Graus */
-
-SDL_Surface* zoom(SDL_Surface* src, int new_w, int new_h)
+/* Fast 32 bpp scaling for zoom().                                       */
+/*                                                                       */
+/* Source and destination have the same pixel format, so each of the     */
+/* four bytes of a pixel can be filtered on its own without unpacking    */
+/* it into RGBA. Everything is done in integers, one destination row at  */
+/* a time:                                                               */
+/*                                                                       */
+/*  - bilinear: the two source rows are first blended vertically into a */
+/*    row buffer (SSE2 when available, 4 pixels at a time), then each    */
+/*    destination pixel is blended horizontally from that buffer.        */
+/*    Weights are 8 bit fractions, so the SSE2 and plain C paths give    */
+/*    exactly the same result.                                           */
+/*  - box: used when shrinking to half size or less, where bilinear      */
+/*    would skip source pixels and alias. Each destination pixel is the  */
+/*    average of the block of source pixels it covers.                   */
+
+typedef struct zoom_job {
+  SDL_Surface* src;
+  SDL_Surface* dst;
+  int box;          /* nonzero to use box filter, else bilinear          */
+  int* col;         /* per dst column: bilinear - left src column,       */
+                    /* box - first src column (new_w + 1 entries)        */
+  Uint8* col_frac;  /* per dst column: bilinear weight of right column   */
+} zoom_job;
+
+static SDL_Surface* zoom_surface(SDL_Surface* src, int new_w, int new_h, int use_pool);
+static int zoom_fast32(SDL_Surface* src, SDL_Surface* dst, int use_pool);
+static int zoom_rows_bilinear32(zoom_job* job, int y0, int y1);
+static int zoom_rows_box32(zoom_job* job, int y0, int y1);
+static void zoom_generic(SDL_Surface* src, SDL_Surface* s);
+static int zoom_run_job(zoom_job* job, int use_pool);
+static void zoom_do_bands(void);
+static int zoom_worker(void* unused);
+static int count_cpus(void);
+
+
+/* Big scaling jobs are split into bands of rows shared out between a   */
+/* small pool of worker threads (started by InitZoomThreads()) and the  */
+/* calling thread. Every row is computed exactly as it would be by a    */
+/* single thread, so the result doesn't depend on how it was split up.  */
+#define ZOOM_MAX_THREADS 8
+#define ZOOM_MIN_PARALLEL_PIXELS (256 * 1024)
+
+static SDL_Thread* zoom_threads[ZOOM_MAX_THREADS];
+static int zoom_num_threads = 0;
+static SDL_mutex* zoom_pool_lock = NULL;  /* one parallel zoom at a time */
+static SDL_mutex* zoom_lock = NULL;       /* protects the fields below   */
+static SDL_sem* zoom_work_sem = NULL;     /* posted once per worker/job  */
+static SDL_sem* zoom_done_sem = NULL;     /* posted by workers when done */
+static zoom_job* zoom_cur_job = NULL;
+static int zoom_next_row = 0;
+static int zoom_band_rows = 0;
+static int zoom_failed = 0;
+static int zoom_quit = 0;
+
+
+/* Scales 'src' into 'dst' if both are 32 bpp (same format), sharing */
+/* the work with the thread pool if 'use_pool' is nonzero.           */
+/* Returns 1 if done, 0 if the caller needs to use zoom_generic():   */
+static int zoom_fast32(SDL_Surface* src, SDL_Surface* dst, int use_pool)
 {
-  SDL_Surface* s;
-
-  /* These function pointers will point to the appropriate */
-  /* putpixel() and getpixel() variants to be used in the  */
-  /* current colorspace:                                   */
-  void (*putpixel) (SDL_Surface*, int, int, Uint32);
-  Uint32(*getpixel) (SDL_Surface*, int, int);
-
-  float xscale, yscale;
-  int x, y;
-  int floor_x, ceil_x,
-        floor_y, ceil_y;
-  float fraction_x, fraction_y,
-        one_minus_x, one_minus_y;
-  float n1, n2;
-  Uint8 r1, g1, b1, a1;
-  Uint8 r2, g2, b2, a2;
-  Uint8 r3, g3, b3, a3;
-  Uint8 r4, g4, b4, a4;
-  Uint8 r, g, b, a;
+  zoom_job job;
+  int x, ok;
 
-  /* Create surface for zoom: */
+  if (src->format->BytesPerPixel != 4 || dst->format->BytesPerPixel != 4)
+    return 0;
 
-  s = SDL_CreateRGBSurface(src->flags,        /* SDL_SWSURFACE, */
-                           new_w, new_h, src->format->BitsPerPixel,
-                           src->format->Rmask,
-                           src->format->Gmask,
-                           src->format->Bmask,
-                           src->format->Amask);
+  job.src = src;
+  job.dst = dst;
+  job.box = (src->w >= 2 * dst->w && src->h >= 2 * dst->h);
+  job.col = malloc((dst->w + 1) * sizeof(int));
+  job.col_frac = malloc(dst->w + 1);
+  if (!job.col || !job.col_frac)
+  {
+    free(job.col);
+    free(job.col_frac);
+    return 0;
+  }
 
-  if (s == NULL)
+  /* Exact integer mapping of each dst column to the src: */
+  for (x = 0; x <= dst->w; x++)
   {
-    fprintf(stderr, "\nError: Can't build zoom surface\n"
-            "The Simple DirectMedia Layer error that occurred was:\n"
-            "%s\n\n", SDL_GetError());
-    return NULL;
-//    cleanup();
-//    exit(1);
+    job.col[x] = (x * src->w) / dst->w;
+    job.col_frac[x] = ((x * src->w) % dst->w) * 256 / dst->w;
   }
 
+  SDL_LockSurface(src);
+  SDL_LockSurface(dst);
 
-  /* Now assign function pointers to correct functions based */
-  /* on data format of original and zoomed surfaces:         */
-  getpixel = getpixels[src->format->BytesPerPixel];
-  putpixel = putpixels[s->format->BytesPerPixel];
+  ok = zoom_run_job(&job, use_pool);
 
-  SDL_LockSurface(src);
-  SDL_LockSurface(s);
+  SDL_UnlockSurface(dst);
+  SDL_UnlockSurface(src);
 
-  xscale = (float) src->w / (float) new_w;
-  yscale = (float) src->h / (float) new_h;
+  free(job.col);
+  free(job.col_frac);
+
+  return ok;
+}
+
+
+/* Bilinear scaling of dst rows 'y0' up to (not including) 'y1': */
+static int zoom_rows_bilinear32(zoom_job* job, int y0, int y1)
+{
+  SDL_Surface* src = job->src;
+  SDL_Surface* dst = job->dst;
+  Uint32* row_buf;
+  int x, y;
+
+  row_buf = malloc(src->w * sizeof(Uint32));
+  if (!row_buf)
+    return 0;
 
-  for (x = 0; x < new_w; x++)
+  for (y = y0; y < y1; y++)
   {
-    for (y = 0; y < new_h; y++)
+    int sy = (y * src->h) / dst->h;
+    Uint32 fy = ((y * src->h) % dst->h) * 256 / dst->h;
+    Uint32* top = (Uint32*)((Uint8*)src->pixels + sy * src->pitch);
+    Uint32* bot = (sy + 1 < src->h) ? (Uint32*)((Uint8*)top + src->pitch) : top;
+    Uint32* out = (Uint32*)((Uint8*)dst->pixels + y * dst->pitch);
+    Uint32* row = top;
+
+    /* Vertical pass, unless we are exactly on a source row: */
+    if (fy != 0)
     {
-      /* Here we calculate the new RGBA values for each pixel */
-      /* using a "weighted average" of the four pixels in the */
-      /* corresponding location in the orginal surface:       */
+      blend_row32(row_buf, top, bot, src->w, fy);
+      row = row_buf;
+    }
 
-      /* figure out which original pixels to use in the calc: */
-      floor_x = floor((float) x * xscale);
-      ceil_x = floor_x + 1;
-      if (ceil_x >= src->w)
-        ceil_x = floor_x;
+    /* Horizontal pass: */
+    for (x = 0; x < dst->w; x++)
+    {
+      int sx = job->col[x];
+      int sx2 = (sx + 1 < src->w) ? sx + 1 : sx;
+      out[x] = blend_pixel(row[sx], row[sx2], job->col_frac[x]);
+    }
+  }
 
-      floor_y = floor((float) y * yscale);
-      ceil_y = floor_y + 1;
-      if (ceil_y >= src->h)
-        ceil_y = floor_y;
+  free(row_buf);
+  return 1;
+}
 
-      fraction_x = x * xscale - floor_x;
-      fraction_y = y * yscale - floor_y;
 
-      one_minus_x = 1.0 - fraction_x;
-      one_minus_y = 1.0 - fraction_y;
+/* Box filter scaling of dst rows 'y0' up to (not including) 'y1': */
+static int zoom_rows_box32(zoom_job* job, int y0, int y1)
+{
+  SDL_Surface* src = job->src;
+  SDL_Surface* dst = job->dst;
+  Uint32* acc;   /* per src column, per byte: sum over the block's rows */
+  int x, y, i;
 
-      /* Grab their values:  */
-      SDL_GetRGBA(getpixel(src, floor_x, floor_y), src->format,
-                  &r1, &g1, &b1, &a1);
-      SDL_GetRGBA(getpixel(src, ceil_x,  floor_y), src->format,
-                  &r2, &g2, &b2, &a2);
-      SDL_GetRGBA(getpixel(src, floor_x, ceil_y),  src->format,
-                  &r3, &g3, &b3, &a3);
-      SDL_GetRGBA(getpixel(src, ceil_x,  ceil_y),  src->format,
-                  &r4, &g4, &b4, &a4);
+  acc = malloc(src->w * 4 * sizeof(Uint32));
+  if (!acc)
+    return 0;
 
-      /* Create the weighted averages: */
-      n1 = (one_minus_x * r1 + fraction_x * r2);
-      n2 = (one_minus_x * r3 + fraction_x * r4);
-      r = (one_minus_y * n1 + fraction_y * n2);
+  for (y = y0; y < y1; y++)
+  {
+    int sy0 = (y * src->h) / dst->h;
+    int sy1 = ((y + 1) * src->h) / dst->h;
+    Uint8* out = (Uint8*)dst->pixels + y * dst->pitch;
+    int sy;
+
+    memset(acc, 0, src->w * 4 * sizeof(Uint32));
+    for (sy = sy0; sy < sy1; sy++)
+    {
+      Uint8* in = (Uint8*)src->pixels + sy * src->pitch;
+      for (i = 0; i < src->w * 4; i++)
+        acc[i] += in[i];
+    }
+
+    for (x = 0; x < dst->w; x++)
+    {
+      int sx0 = job->col[x];
+      int sx1 = job->col[x + 1];
+      Uint32 count = (sx1 - sx0) * (sy1 - sy0);
+      Uint32 sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+
+      for (i = sx0 * 4; i < sx1 * 4; i += 4)
+      {
+        sum0 += acc[i];
+        sum1 += acc[i + 1];
+        sum2 += acc[i + 2];
+        sum3 += acc[i + 3];
+      }
+
+      out[x * 4]     = sum0 / count;
+      out[x * 4 + 1] = sum1 / count;
+      out[x * 4 + 2] = sum2 / count;
+      out[x * 4 + 3] = sum3 / count;
+    }
+  }
+
+  free(acc);
+  return 1;
+}
+
+
+/* Does all the rows of 'job', on the worker threads too if it is worth it */
+/* and 'use_pool' is nonzero. Returns 1 on success, 0 on failure:          */
+static int zoom_run_job(zoom_job* job, int use_pool)
+{
+  int i, ok;
+  int rows = job->dst->h;
+
+  if (!use_pool || zoom_num_threads == 0
+   || job->dst->w * job->dst->h < ZOOM_MIN_PARALLEL_PIXELS)
+  {
+    if (job->box)
+      return zoom_rows_box32(job, 0, rows);
+    else
+      return zoom_rows_bilinear32(job, 0, rows);
+  }
+
+  SDL_mutexP(zoom_pool_lock);
+
+  /* A few bands per thread, so a thread that starts late still helps: */
+  zoom_cur_job = job;
+  zoom_next_row = 0;
+  zoom_band_rows = rows / ((zoom_num_threads + 1) * 4) + 1;
+  zoom_failed = 0;
+
+  for (i = 0; i < zoom_num_threads; i++)
+    SDL_SemPost(zoom_work_sem);
+
+  zoom_do_bands();
+
+  for (i = 0; i < zoom_num_threads; i++)
+    SDL_SemWait(zoom_done_sem);
+
+  ok = !zoom_failed;
+  zoom_cur_job = NULL;
+
+  SDL_mutexV(zoom_pool_lock);
+
+  return ok;
+}
+
+
+/* Takes bands of rows from the current job until there are none left: */
+static void zoom_do_bands(void)
+{
+  zoom_job* job = zoom_cur_job;
+  int y0, y1, ok;
+
+  while (1)
+  {
+    SDL_mutexP(zoom_lock);
+    y0 = zoom_next_row;
+    zoom_next_row += zoom_band_rows;
+    SDL_mutexV(zoom_lock);
+
+    if (y0 >= job->dst->h)
+      break;
+
+    y1 = y0 + zoom_band_rows;
+    if (y1 > job->dst->h)
+      y1 = job->dst->h;
+
+    if (job->box)
+      ok = zoom_rows_box32(job, y0, y1);
+    else
+      ok = zoom_rows_bilinear32(job, y0, y1);
+
+    if (!ok)
+    {
+      SDL_mutexP(zoom_lock);
+      zoom_failed = 1;
+      SDL_mutexV(zoom_lock);
+    }
+  }
+}
+
+
+static int zoom_worker(void* unused)
+{
+  while (1)
+  {
+    SDL_SemWait(zoom_work_sem);
+    if (zoom_quit)
+      break;
+    zoom_do_bands();
+    SDL_SemPost(zoom_done_sem);
+  }
+  return 0;
+}
+
+
+static int count_cpus(void)
+{
+  int n = 1;
+#ifdef WIN32
+  char* env = getenv("NUMBER_OF_PROCESSORS");
+  if (env)
+    n = atoi(env);
+#elif defined(_SC_NPROCESSORS_ONLN)
+  n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  return (n > 0) ? n : 1;
+}
+
+
+/**********************
+InitZoomThreads(): start the worker
+threads used by zoom() - one less than
+the number of CPUs, as the calling
+thread does its share too
+**********************/
+void InitZoomThreads(void)
+{
+  int i, n;
+
+  if (zoom_num_threads > 0)
+    return;
+
+  n = count_cpus() - 1;
+  if (n > ZOOM_MAX_THREADS)
+    n = ZOOM_MAX_THREADS;
+  if (n <= 0)
+    return;
+
+  zoom_pool_lock = SDL_CreateMutex();
+  zoom_lock = SDL_CreateMutex();
+  zoom_work_sem = SDL_CreateSemaphore(0);
+  zoom_done_sem = SDL_CreateSemaphore(0);
+  if (!zoom_pool_lock || !zoom_lock || !zoom_work_sem || !zoom_done_sem)
+  {
+    fprintf(stderr, "InitZoomThreads() - could not create sync objects: %s\n",
+            SDL_GetError());
+    FreeZoomThreads();
+    return;
+  }
+
+  zoom_quit = 0;
+  for (i = 0; i < n; i++)
+  {
+    zoom_threads[i] = SDL_CreateThread(zoom_worker, NULL);
+    if (!zoom_threads[i])
+      break;
+    zoom_num_threads++;
+  }
+
+  DEBUGCODE
+  {
+    fprintf(stderr, "InitZoomThreads(): %d worker threads\n", zoom_num_threads);
+  }
+}
+
+
+/**********************
+FreeZoomThreads(): stop the worker
+threads and free what they used
+**********************/
+void FreeZoomThreads(void)
+{
+  int i;
+
+  zoom_quit = 1;
+  for (i = 0; i < zoom_num_threads; i++)
+    SDL_SemPost(zoom_work_sem);
+  for (i = 0; i < zoom_num_threads; i++)
+  {
+    SDL_WaitThread(zoom_threads[i], NULL);
+    zoom_threads[i] = NULL;
+  }
+  zoom_num_threads = 0;
+
+  if (zoom_done_sem)
+    SDL_DestroySemaphore(zoom_done_sem);
+  if (zoom_work_sem)
+    SDL_DestroySemaphore(zoom_work_sem);
+  if (zoom_lock)
+    SDL_DestroyMutex(zoom_lock);
+  if (zoom_pool_lock)
+    SDL_DestroyMutex(zoom_pool_lock);
+  zoom_done_sem = zoom_work_sem = NULL;
+  zoom_lock = zoom_pool_lock = NULL;
+}
+
+
+/* Swiped shamelessly from TuxPaint
+   Based on code from: http://www.codeproject.com/cs/media/imageprocessing4.asp
+   copyright 2002 Christian Graus */
+
+SDL_Surface* zoom(SDL_Surface* src, int new_w, int new_h)
+{
+  return zoom_surface(src, new_w, new_h, 1);
+}
+
+
+/* Same as zoom(), but all done on the calling thread - for threads other */
+/* than the main one, which must not wait on the shared worker pool:      */
+SDL_Surface* zoom_serial(SDL_Surface* src, int new_w, int new_h)
+{
+  return zoom_surface(src, new_w, new_h, 0);
+}
+
+
+static SDL_Surface* zoom_surface(SDL_Surface* src, int new_w, int new_h, int use_pool)
+{
+  SDL_Surface* s;
+
+  /* Create surface for zoom: */
+
+  s = SDL_CreateRGBSurface(src->flags,        /* SDL_SWSURFACE, */
+                           new_w, new_h, src->format->BitsPerPixel,
+                           src->format->Rmask,
+                           src->format->Gmask,
+                           src->format->Bmask,
+                           src->format->Amask);
+
+  if (s == NULL)
+  {
+    fprintf(stderr, "\nError: Can't build zoom surface\n"
+            "The Simple DirectMedia Layer error that occurred was:\n"
+            "%s\n\n", SDL_GetError());
+    return NULL;
+//    cleanup();
+//    exit(1);
+  }
+
+  /* Use the fast integer scaler when we can, else the generic one that */
+  /* handles any pixel format:                                          */
+  if (!zoom_fast32(src, s, use_pool))
+    zoom_generic(src, s);
+
+  return s;
+}
+
+
+/* Generic (slow) bilinear scaling of 'src' into 's', for any pixel format: */
+static void zoom_generic(SDL_Surface* src, SDL_Surface* s)
+{
+  /* These function pointers will point to the appropriate */
+  /* putpixel() and getpixel() variants to be used in the  */
+  /* current colorspace:                                   */
+  void (*putpixel) (SDL_Surface*, int, int, Uint32);
+  Uint32(*getpixel) (SDL_Surface*, int, int);
+
+  float xscale, yscale;
+  int x, y;
+  int new_w = s->w, new_h = s->h;
+  int floor_x, ceil_x,
+        floor_y, ceil_y;
+  float fraction_x, fraction_y,
+        one_minus_x, one_minus_y;
+  float n1, n2;
+  Uint8 r1, g1, b1, a1;
+  Uint8 r2, g2, b2, a2;
+  Uint8 r3, g3, b3, a3;
+  Uint8 r4, g4, b4, a4;
+  Uint8 r, g, b, a;
+
+  /* Now assign function pointers to correct functions based */
+  /* on data format of original and zoomed surfaces:         */
+  getpixel = getpixels[src->format->BytesPerPixel];
+  putpixel = putpixels[s->format->BytesPerPixel];
+
+  SDL_LockSurface(src);
+  SDL_LockSurface(s);
+
+  xscale = (float) src->w / (float) new_w;
+  yscale = (float) src->h / (float) new_h;
+
+  for (y = 0; y < new_h; y++)
+  {
+    for (x = 0; x < new_w; x++)
+    {
+      /* Here we calculate the new RGBA values for each pixel */
+      /* using a "weighted average" of the four pixels in the */
+      /* corresponding location in the orginal surface:       */
+
+      /* figure out which original pixels to use in the calc: */
+      floor_x = floor((float) x * xscale);
+      ceil_x = floor_x + 1;
+      if (ceil_x >= src->w)
+        ceil_x = floor_x;
+
+      floor_y = floor((float) y * yscale);
+      ceil_y = floor_y + 1;
+      if (ceil_y >= src->h)
+        ceil_y = floor_y;
+
+      fraction_x = x * xscale - floor_x;
+      fraction_y = y * yscale - floor_y;
+
+      one_minus_x = 1.0 - fraction_x;
+      one_minus_y = 1.0 - fraction_y;
+
+      /* Grab their values:  */
+      SDL_GetRGBA(getpixel(src, floor_x, floor_y), src->format,
+                  &r1, &g1, &b1, &a1);
+      SDL_GetRGBA(getpixel(src, ceil_x,  floor_y), src->format,
+                  &r2, &g2, &b2, &a2);
+      SDL_GetRGBA(getpixel(src, floor_x, ceil_y),  src->format,
+                  &r3, &g3, &b3, &a3);
+      SDL_GetRGBA(getpixel(src, ceil_x,  ceil_y),  src->format,
+                  &r4, &g4, &b4, &a4);
+
+      /* Create the weighted averages: */
+      n1 = (one_minus_x * r1 + fraction_x * r2);
+      n2 = (one_minus_x * r3 + fraction_x * r4);
+      r = (one_minus_y * n1 + fraction_y * n2);
 
       n1 = (one_minus_x * g1 + fraction_x * g2);
       n2 = (one_minus_x * g3 + fraction_x * g4);
@@ -601,8 +1254,6 @@ SDL_Surface* zoom(SDL_Surface* src, int new_w, int new_h)
 
   SDL_UnlockSurface(s);
   SDL_UnlockSurface(src);
-
-  return s;
 }
 
 
@@ -809,20 +1460,44 @@ int TransWipe(const SDL_Surface* newbkg, int type, int segments, int duration)
 /* optimized fashion.                                                   */
 /************************************************************************/
 
-//With fullscreen, we need more updates - 180 wasn't enough
-#define MAX_UPDATES 512
-
 /* --- Data Structure for Dirty Blitting --- */
-static SDL_Rect srcupdate[MAX_UPDATES];
-static SDL_Rect dstupdate[MAX_UPDATES];
-static int numupdates = 0; // tracks how many blits to be done
+/* Erase and draw orders go into separate lists, so UpdateScreen() just  */
+/* walks each in turn. The lists grow whenever a frame needs more room   */
+/* (e.g. fullscreen at high resolution) and are emptied, but not freed,  */
+/* at the end of each frame - so once they have grown to fit a typical   */
+/* frame, queuing a blit costs no allocation at all.                     */
+#define BLIT_QUEUE_INIT_SIZE 512
 
 struct blit {
     SDL_Surface* src;
-    SDL_Rect* srcrect;
-    SDL_Rect* dstrect;
-    unsigned char type;
-} blits[MAX_UPDATES];
+    SDL_Rect srcrect;
+    SDL_Rect dstrect;
+};
+
+typedef struct blit_queue {
+    struct blit* blits;
+    int num;    // blits queued this frame
+    int max;    // blits allocated
+} blit_queue;
+
+static blit_queue erase_queue = {NULL, 0, 0};
+static blit_queue draw_queue = {NULL, 0, 0};
+
+/* Screen areas to pass to SDL_UpdateRects() - the blit destinations plus */
+/* anything added with AddRect():                                         */
+static SDL_Rect* update_rects = NULL;
+static int num_update_rects = 0;
+static int max_update_rects = 0;
+
+/* Two update rects get merged into their bounding box if that means    */
+/* refreshing no more than this many pixels that neither rect covers -  */
+/* roughly what a separate update call costs us:                        */
+#define UPDATE_MERGE_WASTE 1024
+
+static int grow_array(void** array, int* max, int needed, size_t elem_size);
+static struct blit* new_blit(blit_queue* q);
+static SDL_Rect* new_update_rect(void);
+static int compare_rect_x(const void* a, const void* b);
 
 
 
@@ -831,15 +1506,14 @@ struct blit {
  ***********************/
 void InitBlitQueue(void)
 {
-  int i;
-
-  /* --- Set up the update rectangle pointers --- */
-  for (i = 0; i < MAX_UPDATES; ++i)
-  {
-    blits[i].srcrect = &srcupdate[i];
-    blits[i].dstrect = &dstupdate[i];
-  }
-  numupdates = 0;
+  /* Start out with a reasonable size so we rarely need to grow: */
+  grow_array((void**)&erase_queue.blits, &erase_queue.max,
+             BLIT_QUEUE_INIT_SIZE, sizeof(struct blit));
+  grow_array((void**)&draw_queue.blits, &draw_queue.max,
+             BLIT_QUEUE_INIT_SIZE, sizeof(struct blit));
+  grow_array((void**)&update_rects, &max_update_rects,
+             BLIT_QUEUE_INIT_SIZE * 2, sizeof(SDL_Rect));
+  ResetBlitQueue();
 }
 
 
@@ -849,7 +1523,75 @@ of pending updates to zero
 ***************************/
 void ResetBlitQueue(void)
 {
-  numupdates = 0;
+  erase_queue.num = 0;
+  draw_queue.num = 0;
+  num_update_rects = 0;
+}
+
+
+/**************************
+FreeBlitQueue(): release the memory
+used by the blit queue
+***************************/
+void FreeBlitQueue(void)
+{
+  free(erase_queue.blits);
+  erase_queue.blits = NULL;
+  erase_queue.max = 0;
+  free(draw_queue.blits);
+  draw_queue.blits = NULL;
+  draw_queue.max = 0;
+  free(update_rects);
+  update_rects = NULL;
+  max_update_rects = 0;
+  ResetBlitQueue();
+}
+
+
+/* Makes sure '*array' has room for at least 'needed' elements of size  */
+/* 'elem_size', doubling its allocation as often as necessary.          */
+/* Returns 1 on success, 0 if out of memory (array left untouched):     */
+static int grow_array(void** array, int* max, int needed, size_t elem_size)
+{
+  int new_max;
+  void* p;
+
+  if (needed <= *max)
+    return 1;
+
+  new_max = *max ? *max : BLIT_QUEUE_INIT_SIZE;
+  while (new_max < needed)
+    new_max *= 2;
+
+  p = realloc(*array, new_max * elem_size);
+  if (!p)
+  {
+    fprintf(stderr, "Warning - could not grow blit queue to %d entries\n", new_max);
+    return 0;
+  }
+
+  *array = p;
+  *max = new_max;
+  return 1;
+}
+
+
+/* Returns the next free slot in 'q', or NULL if we ran out of memory: */
+static struct blit* new_blit(blit_queue* q)
+{
+  if (!grow_array((void**)&q->blits, &q->max, q->num + 1, sizeof(struct blit)))
+    return NULL;
+  return &q->blits[q->num++];
+}
+
+
+/* Returns the next free update rect, or NULL if we ran out of memory: */
+static SDL_Rect* new_update_rect(void)
+{
+  if (!grow_array((void**)&update_rects, &max_update_rects,
+                  num_update_rects + 1, sizeof(SDL_Rect)))
+    return NULL;
+  return &update_rects[num_update_rects++];
 }
 
 
@@ -860,9 +1602,7 @@ AddRect : Don't actually blit a surface,
 *******************************/
 int AddRect(SDL_Rect* src, SDL_Rect* dst)
 {
-
-  /*borrowed from SL's alien (and modified)*/
-  struct blit* update;
+  SDL_Rect* update;
 
   if(!src)
   {
@@ -876,40 +1616,42 @@ int AddRect(SDL_Rect* src, SDL_Rect* dst)
     return 0;
   }
 
-  if(numupdates >= MAX_UPDATES)
-  {
-    fprintf(stderr, "Warning - MAX_UPDATES exceeded, cannot add blit to queue\n");
-    return 0;
-  }
-
-  update = &blits[numupdates++];
+  update = new_update_rect();
 
-  if(!update || !update->srcrect || !update->dstrect)
+  if(!update)
   {
-    fprintf(stderr, "AddRect() - 'update' ptr invalid!\n");
+    fprintf(stderr, "AddRect() - cannot add rect to queue\n");
     return 0;
   }
 
-  update->srcrect->x = src->x;
-  update->srcrect->y = src->y;
-  update->srcrect->w = src->w;
-  update->srcrect->h = src->h;
-  update->dstrect->x = dst->x;
-  update->dstrect->y = dst->y;
-  update->dstrect->w = dst->w;
-  update->dstrect->h = dst->h;
-  update->type = 'I';
+  *update = *dst;
 
   return 1;
 }
 
 
 
+/* Returns frame 'n' of 'gfx', first mirroring it from the source */
+/* sprite if 'gfx' was made by FlipSprite() and the frame hasn't   */
+/* been needed yet. Returns NULL if there is no such frame:        */
+SDL_Surface* SpriteFrame(sprite* gfx, int n)
+{
+  if (!gfx || n < 0 || n >= MAX_SPRITE_FRAMES)
+    return NULL;
+
+  if (!gfx->frame[n] && gfx->flip_src && n < gfx->num_frames
+   && gfx->flip_src->frame[n])
+    gfx->frame[n] = Flip(gfx->flip_src->frame[n], gfx->flip_x, gfx->flip_y);
+
+  return gfx->frame[n];
+}
+
+
 int DrawSprite(sprite* gfx, int x, int y)
 {
   LOG("Entering DrawSprite()\n");
 
-  if (!gfx || !gfx->frame[gfx->cur])
+  if (!gfx || !SpriteFrame(gfx, gfx->cur))
   {
     fprintf(stderr, "DrawSprite() - 'gfx' arg invalid!\n");
     LOG("Leaving DrawSprite()\n");
@@ -940,32 +1682,25 @@ int DrawObject(SDL_Surface* surf, int x, int y)
     return 0;
   }
 
-  DOUT(numupdates);
+  DOUT(draw_queue.num);
 
-  if(numupdates >= MAX_UPDATES)
+  update = new_blit(&draw_queue);
+
+  if(!update)
   {
-    fprintf(stderr, "Warning - MAX_UPDATES exceeded, cannot add blit to queue\n");
+    fprintf(stderr, "DrawObject() - cannot add blit to queue\n");
     return 0;
   }
 
-  update = &blits[numupdates++];
-
-  if(!update || !update->srcrect || !update->dstrect)
-  {
-    fprintf(stderr, "DrawObject() - 'update' ptr invalid!\n");
-    return 0;
-  }
-
-  update->src = surf;
-  update->srcrect->x = 0;
-  update->srcrect->y = 0;
-  update->srcrect->w = surf->w;
-  update->srcrect->h = surf->h;
-  update->dstrect->x = x;
-  update->dstrect->y = y;
-  update->dstrect->w = surf->w;
-  update->dstrect->h = surf->h;
-  update->type = 'D';
+  update->src = surf;
+  update->srcrect.x = 0;
+  update->srcrect.y = 0;
+  update->srcrect.w = surf->w;
+  update->srcrect.h = surf->h;
+  update->dstrect.x = x;
+  update->dstrect.y = y;
+  update->dstrect.w = surf->w;
+  update->dstrect.h = surf->h;
 
   LOG("Leaving DrawObject()\n");
 
@@ -979,27 +1714,33 @@ UpdateScreen : Update the screen and increment the frame num
 ***************************/
 void UpdateScreen(int* frame)
 {
-  int i;
+  struct blit* b;
+  struct blit* end;
+  int n;
 
   LOG("Entering UpdateScreen()\n");
-  DOUT(numupdates);
+  DOUT(erase_queue.num);
+  DOUT(draw_queue.num);
+
+  /* Every blit contributes one update rect - make room for them all now: */
+  if (!grow_array((void**)&update_rects, &max_update_rects,
+                  num_update_rects + erase_queue.num + draw_queue.num,
+                  sizeof(SDL_Rect)))
+  {
+    /* Can't track the dirty areas, so just refresh the whole screen: */
+    num_update_rects = 0;
+    erase_queue.num = draw_queue.num = 0;
+    SDL_UpdateRect(screen, 0, 0, 0, 0);
+    *frame = *frame + 1;
+    return;
+  }
 
   /* -- First erase everything we need to -- */
-  for (i = 0; i < numupdates; i++)
+  end = erase_queue.blits + erase_queue.num;
+  for (b = erase_queue.blits; b < end; b++)
   {
-    if (blits[i].type == 'E') 
-    {
-//       DEBUGCODE
-//       {
-//         fprintf(stderr, "Erasing blits[%d]\n", i);
-//         fprintf(stderr, "srcrect->x = %d\t srcrect->y = %d\t srcrect->w = %d\t srcrect->h = %d\n",
-//               blits[i].srcrect->x, blits[i].srcrect->y, blits[i].srcrect->w, blits[i].srcrect->h);
-//         fprintf(stderr, "dstrect->x = %d\t dstrect->y = %d\t dstrect->w = %d\t dstrect->h = %d\n",
-//               blits[i].dstrect->x, blits[i].dstrect->y, blits[i].dstrect->w, blits[i].dstrect->h);
-//       }
-
-      SDL_LowerBlit(blits[i].src, blits[i].srcrect, screen, blits[i].dstrect);
-    }
+    SDL_LowerBlit(b->src, &b->srcrect, screen, &b->dstrect);
+    update_rects[num_update_rects++] = b->dstrect;
   }
 
   LOG("Done erasing\n");
@@ -1007,21 +1748,12 @@ void UpdateScreen(int* frame)
 //  SNOW_erase();
 
   /* -- then draw -- */ 
-  for (i = 0; i < numupdates; i++)
+  end = draw_queue.blits + draw_queue.num;
+  for (b = draw_queue.blits; b < end; b++)
   {
-    if (blits[i].type == 'D') 
-    {
-//       DEBUGCODE
-//       {
-//         fprintf(stderr, "drawing blits[%d]\n", i);
-//         fprintf(stderr, "srcrect->x = %d\t srcrect->y = %d\t srcrect->w = %d\t srcrect->h = %d\n",
-//               blits[i].srcrect->x, blits[i].srcrect->y, blits[i].srcrect->w, blits[i].srcrect->h);
-//         fprintf(stderr, "dstrect->x = %d\t dstrect->y = %d\t dstrect->w = %d\t dstrect->h = %d\n",
-//               blits[i].dstrect->x, blits[i].dstrect->y, blits[i].dstrect->w, blits[i].dstrect->h);
-//       } 
-
-      SDL_BlitSurface(blits[i].src, blits[i].srcrect, screen, blits[i].dstrect);
-    } 
+    /* NOTE SDL_BlitSurface() clips dstrect to what was actually drawn */
+    SDL_BlitSurface(b->src, &b->srcrect, screen, &b->dstrect);
+    update_rects[num_update_rects++] = b->dstrect;
   }
 
   LOG("Done drawing\n");
@@ -1029,30 +1761,143 @@ void UpdateScreen(int* frame)
 //  SNOW_draw();
 
   /* -- update the screen only where we need to! -- */
-//  if (SNOW_on) 
-//    SDL_UpdateRects(screen, SNOW_add( (SDL_Rect*)&dstupdate, numupdates ), SNOW_rects);
-//  else 
-    SDL_UpdateRects(screen, numupdates, dstupdate);
+  n = MergeRects(update_rects, num_update_rects);
 
-  numupdates = 0;
+  DEBUGCODE
+  {
+    fprintf(stderr, "UpdateScreen(): %d update rects, %d after merging\n",
+            num_update_rects, n);
+  }
+
+  SDL_UpdateRects(screen, n, update_rects);
+
+  ResetBlitQueue();
   *frame = *frame + 1;
 
   LOG("Leaving UpdateScreen()\n");
 }
 
 
+/* qsort() comparison for MergeRects(): orders rects by left edge */
+static int compare_rect_x(const void* a, const void* b)
+{
+  return ((const SDL_Rect*)a)->x - ((const SDL_Rect*)b)->x;
+}
+
+
+/* MergeRects() coalesces the 'n' screen update rects in 'rects' in     */
+/* place, so that overlapping or adjoining rects are refreshed once.     */
+/* Rects are clipped to the screen and empty ones dropped. Two rects are */
+/* replaced by their bounding box when that costs at most                */
+/* UPDATE_MERGE_WASTE pixels that neither of them needed. The result     */
+/* may still contain (slightly) overlapping rects.                       */
+/* Returns the new number of rects:                                      */
+int MergeRects(SDL_Rect* rects, int n)
+{
+  int i, j, count = 0;
+  int merged;
+
+  /* Clip to screen, dropping anything that ends up empty: */
+  for (i = 0; i < n; i++)
+  {
+    int x1 = rects[i].x;
+    int y1 = rects[i].y;
+    int x2 = x1 + rects[i].w;
+    int y2 = y1 + rects[i].h;
+
+    if (x1 < 0) x1 = 0;
+    if (y1 < 0) y1 = 0;
+    if (x2 > screen->w) x2 = screen->w;
+    if (y2 > screen->h) y2 = screen->h;
+    if (x2 <= x1 || y2 <= y1)
+      continue;
+
+    rects[count].x = x1;
+    rects[count].y = y1;
+    rects[count].w = x2 - x1;
+    rects[count].h = y2 - y1;
+    count++;
+  }
+
+  if (count < 2)
+    return count;
+
+  /* Sweep from left to right - once a rect starts past the right edge of */
+  /* rects[i], no later one can touch it either. Merging can make a rect  */
+  /* grow into others already passed over, so repeat until nothing moves: */
+  qsort(rects, count, sizeof(SDL_Rect), compare_rect_x);
+
+  do
+  {
+    merged = 0;
+
+    for (i = 0; i < count; i++)
+    {
+      if (rects[i].w == 0)
+        continue;
+
+      for (j = i + 1; j < count && rects[j].x <= rects[i].x + rects[i].w; j++)
+      {
+        int x1, y1, x2, y2, ox, oy;
+        long area_i, area_j, area_u, overlap;
+
+        if (rects[j].w == 0)
+          continue;
+
+        /* rects[j].x >= rects[i].x because of the sort: */
+        x1 = rects[i].x;
+        y1 = rects[i].y < rects[j].y ? rects[i].y : rects[j].y;
+        x2 = rects[i].x + rects[i].w;
+        if (rects[j].x + rects[j].w > x2)
+          x2 = rects[j].x + rects[j].w;
+        y2 = rects[i].y + rects[i].h;
+        if (rects[j].y + rects[j].h > y2)
+          y2 = rects[j].y + rects[j].h;
+
+        /* Size of the overlap, if any: */
+        ox = (rects[i].x + rects[i].w < rects[j].x + rects[j].w ?
+              rects[i].x + rects[i].w : rects[j].x + rects[j].w) - rects[j].x;
+        oy = (rects[i].y + rects[i].h < rects[j].y + rects[j].h ?
+              rects[i].y + rects[i].h : rects[j].y + rects[j].h)
+           - (rects[i].y > rects[j].y ? rects[i].y : rects[j].y);
+        overlap = (ox > 0 && oy > 0) ? (long)ox * oy : 0;
+
+        area_i = (long)rects[i].w * rects[i].h;
+        area_j = (long)rects[j].w * rects[j].h;
+        area_u = (long)(x2 - x1) * (y2 - y1);
+
+        if (area_u - (area_i + area_j - overlap) > UPDATE_MERGE_WASTE)
+          continue;
+
+        rects[i].y = y1;
+        rects[i].w = x2 - x1;
+        rects[i].h = y2 - y1;
+        rects[j].w = 0;   /* mark as absorbed */
+        merged = 1;
+      }
+    }
+  }
+  while (merged);
+
+  /* Squeeze out absorbed rects: */
+  for (i = 0, j = 0; i < count; i++)
+    if (rects[i].w != 0)
+      rects[j++] = rects[i];
+
+  return j;
+}
+
+
 /* basically puts in an order to overdraw sprite with corresponding */
 /* rect of bkgd img                                                 */
 int EraseSprite(sprite* img, int x, int y)
 {
-//  struct blit* update;
-
   LOG("Entering EraseSprite()\n");
 
   if( !img 
    || img->cur < 0
-   || img->cur > MAX_SPRITE_FRAMES
-   || !img->frame[img->cur])
+   || img->cur >= MAX_SPRITE_FRAMES
+   || !SpriteFrame(img, img->cur))
   {
     fprintf(stderr, "EraseSprite() - invalid 'img' arg!\n");
     LOG("Leaving EraseSprite()\n");
@@ -1072,6 +1917,7 @@ EraseObject : Erase an object from the screen
 int EraseObject(SDL_Surface* surf, int x, int y)
 {
   struct blit* update = NULL;
+  SDL_Surface* bkgd = NULL;
 
   LOG("Entering EraseObject()\n");
 
@@ -1081,61 +1927,59 @@ int EraseObject(SDL_Surface* surf, int x, int y)
     return 0;
   }
 
-  if(numupdates >= MAX_UPDATES)
+  /* This may have to load the background, which can fail: */
+  bkgd = CurrentBkgd();
+  if (!bkgd)
   {
-    fprintf(stderr, "Warning - MAX_UPDATES exceeded, cannot add blit to queue\n");
+    fprintf(stderr, "EraseObject() - no background to erase with\n");
     return 0;
   }
 
-  update = &blits[numupdates++];
+  update = new_blit(&erase_queue);
 
-  if(!update || !update->srcrect || !update->dstrect)
+  if(!update)
   {
-    fprintf(stderr, "EraseObject() - 'update' ptr invalid!\n");
+    fprintf(stderr, "EraseObject() - cannot add blit to queue\n");
     return 0;
   }
 
-  update->src = CurrentBkgd();
+  update->src = bkgd;
 
   /* take dimentsions from src surface: */
-  update->srcrect->x = x;
-  update->srcrect->y = y;
-  update->srcrect->w = surf->w;
-  update->srcrect->h = surf->h;
+  update->srcrect.x = x;
+  update->srcrect.y = y;
+  update->srcrect.w = surf->w;
+  update->srcrect.h = surf->h;
 
   /* NOTE this is needed because the letters may go beyond the size of */
   /* the fish, and we only erase the fish image before we redraw the   */
   /* fish followed by the letter - DSB                                 */
   /* add margin of a few pixels on each side: */
-  update->srcrect->x -= ERASE_MARGIN;
-  update->srcrect->y -= ERASE_MARGIN;
-  update->srcrect->w += (ERASE_MARGIN * 2);
-  update->srcrect->h += (ERASE_MARGIN * 2);
+  update->srcrect.x -= ERASE_MARGIN;
+  update->srcrect.y -= ERASE_MARGIN;
+  update->srcrect.w += (ERASE_MARGIN * 2);
+  update->srcrect.h += (ERASE_MARGIN * 2);
 
 
   /* Adjust srcrect so it doesn't go past bkgd: */
-  if (update->srcrect->x < 0)
+  if (update->srcrect.x < 0)
   {
-    update->srcrect->w += update->srcrect->x; //so right edge stays correct
-    update->srcrect->x = 0;
+    update->srcrect.w += update->srcrect.x; //so right edge stays correct
+    update->srcrect.x = 0;
   }
-  if (update->srcrect->y < 0)
+  if (update->srcrect.y < 0)
   {
-    update->srcrect->h += update->srcrect->y; //so bottom edge stays correct
-    update->srcrect->y = 0;
+    update->srcrect.h += update->srcrect.y; //so bottom edge stays correct
+    update->srcrect.y = 0;
   }
 
-  if (update->srcrect->x + update->srcrect->w > CurrentBkgd()->w)
-    update->srcrect->w = CurrentBkgd()->w - update->srcrect->x;
-  if (update->srcrect->y + update->srcrect->h > CurrentBkgd()->h)
-    update->srcrect->h = CurrentBkgd()->h - update->srcrect->y;
+  if (update->srcrect.x + update->srcrect.w > bkgd->w)
+    update->srcrect.w = bkgd->w - update->srcrect.x;
+  if (update->srcrect.y + update->srcrect.h > bkgd->h)
+    update->srcrect.h = bkgd->h - update->srcrect.y;
 
 
-  update->dstrect->x = update->srcrect->x;
-  update->dstrect->y = update->srcrect->y;
-  update->dstrect->w = update->srcrect->w;
-  update->dstrect->h = update->srcrect->h; 
-  update->type = 'E';
+  update->dstrect = update->srcrect;
 
   LOG("Leaving EraseObject()\n");
 
@@ -1166,9 +2010,22 @@ int EraseObject(SDL_Surface* surf, int x, int y)
 #ifdef HAVE_LIBSDL_PANGO
 #include "SDL_Pango.h"
 
+/* Number of (font, size) contexts kept around at once: */
+#define PANGO_CONTEXT_POOL_SIZE 8
+
+typedef struct {
+  SDLPango_Context* context;
+  int size;
+  char font_name[FNLEN];
+  unsigned long last_used;
+} pango_pool_entry;
+
+/* The context for the current font size - one of those in context_pool[]: */
 SDLPango_Context* context = NULL;
+static pango_pool_entry context_pool[PANGO_CONTEXT_POOL_SIZE];
 static SDLPango_Matrix* SDL_Colour_to_SDLPango_Matrix(const SDL_Color* cl);
 static int Set_SDL_Pango_Font_Size(int size);
+static void free_context_pool(void);
 
 
 
@@ -1184,7 +2041,6 @@ static TTF_Font* load_font(const char* font_name, int font_size);
 
 
 
-
 /* "Public" functions called from other files that use either */
 /*SDL_Pango or SDL_ttf:                                       */
 
@@ -1222,10 +2078,9 @@ int Setup_SDL_Text(void)
 
 void Cleanup_SDL_Text(void)
 {
+  FlushTextCache();
 #ifdef HAVE_LIBSDL_PANGO
-  if(context != NULL)
-    SDLPango_FreeContext(context);
-  context = NULL;
+  free_context_pool();
 #else
   free_font_list();
   TTF_Quit();
@@ -1233,160 +2088,477 @@ void Cleanup_SDL_Text(void)
 }
 
 
+/* Text surface cache ------------------------------------------------------ */
+/* BlackOutline() and SimpleText() keep what they render in a small LRU     */
+/* cache keyed by (text, size, color, outline, font name), so menus and     */
+/* practice-mode labels that show the same strings again don't re-render    */
+/* them. The cache hands out the same surface each time, bumping SDL's own  */
+/* reference count - callers still just SDL_FreeSurface() what they get,    */
+/* and a surface evicted from the cache stays alive until its last user     */
+/* frees it. Callers must therefore treat returned surfaces as read-only.   */
+
+#define TEXT_CACHE_BUCKETS 256
+#define TEXT_CACHE_MAX_ENTRIES 512
+#define TEXT_CACHE_MAX_BYTES (4 * 1024 * 1024)
+
+typedef struct text_cache_entry {
+  char* text;
+  char font_name[FNLEN];
+  int size;
+  SDL_Color col;
+  int outline;
+  Uint32 hash;
+  SDL_Surface* surf;
+  unsigned long bytes;
+  struct text_cache_entry* hash_next;
+  struct text_cache_entry* lru_prev;  /* toward most recently used */
+  struct text_cache_entry* lru_next;  /* toward least recently used */
+} text_cache_entry;
+
+static text_cache_entry* text_cache[TEXT_CACHE_BUCKETS] = {NULL};
+static text_cache_entry* text_cache_mru = NULL;
+static text_cache_entry* text_cache_lru = NULL;
+static text_cache_stats text_stats = {0, 0, 0, 0, 0};
+
+
+static Uint32 text_cache_hash(const char* t, int size, const SDL_Color* col, int outline)
+{
+  /* FNV-1a: */
+  Uint32 h = 2166136261u;
+  const char* p;
+
+  for (p = t; *p; p++)
+    h = (h ^ (Uint8)*p) * 16777619u;
+  for (p = settings.theme_font_name; *p; p++)
+    h = (h ^ (Uint8)*p) * 16777619u;
+  h = (h ^ (Uint32)size) * 16777619u;
+  h = (h ^ col->r) * 16777619u;
+  h = (h ^ col->g) * 16777619u;
+  h = (h ^ col->b) * 16777619u;
+  h = (h ^ (Uint32)outline) * 16777619u;
+  return h;
+}
+
+
+static void text_cache_unlink_lru(text_cache_entry* e)
+{
+  if (e->lru_prev)
+    e->lru_prev->lru_next = e->lru_next;
+  else
+    text_cache_mru = e->lru_next;
+  if (e->lru_next)
+    e->lru_next->lru_prev = e->lru_prev;
+  else
+    text_cache_lru = e->lru_prev;
+  e->lru_prev = e->lru_next = NULL;
+}
+
+
+static void text_cache_push_mru(text_cache_entry* e)
+{
+  e->lru_prev = NULL;
+  e->lru_next = text_cache_mru;
+  if (text_cache_mru)
+    text_cache_mru->lru_prev = e;
+  text_cache_mru = e;
+  if (!text_cache_lru)
+    text_cache_lru = e;
+}
+
+
+/* Takes 'e' out of the cache and drops the cache's reference to its surface: */
+static void text_cache_remove(text_cache_entry* e)
+{
+  text_cache_entry** link = &text_cache[e->hash % TEXT_CACHE_BUCKETS];
+
+  while (*link && *link != e)
+    link = &(*link)->hash_next;
+  if (*link)
+    *link = e->hash_next;
+
+  text_cache_unlink_lru(e);
+  text_stats.bytes -= e->bytes;
+  text_stats.entries--;
+  SDL_FreeSurface(e->surf);
+  free(e->text);
+  free(e);
+}
+
+
+/* Returns the entry for this text in the current font, or NULL: */
+static text_cache_entry* text_cache_find(Uint32 h, const char* t, int size, const SDL_Color* col, int outline)
+{
+  text_cache_entry* e;
+
+  for (e = text_cache[h % TEXT_CACHE_BUCKETS]; e; e = e->hash_next)
+    if (e->hash == h && e->size == size && e->outline == outline
+     && e->col.r == col->r && e->col.g == col->g && e->col.b == col->b
+     && 0 == strcmp(e->text, t)
+     && 0 == strncmp(e->font_name, settings.theme_font_name, FNLEN))
+      return e;
+
+  return NULL;
+}
+
+
+/* Returns a new reference to the cached surface, or NULL if not cached: */
+static SDL_Surface* text_cache_get(const char* t, int size, const SDL_Color* col, int outline)
+{
+  Uint32 h = text_cache_hash(t, size, col, outline);
+  text_cache_entry* e = text_cache_find(h, t, size, col, outline);
+
+  if (e)
+  {
+    text_stats.hits++;
+    text_cache_unlink_lru(e);
+    text_cache_push_mru(e);
+    e->surf->refcount++;
+    return e->surf;
+  }
+
+  text_stats.misses++;
+  return NULL;
+}
+
+
+/* Adds 'surf' to the cache (which takes its own reference to it),  */
+/* replacing any entry with the same key and evicting the least     */
+/* recently used entries if over the limits:                        */
+static void text_cache_put(const char* t, int size, const SDL_Color* col, int outline, SDL_Surface* surf)
+{
+  text_cache_entry* e;
+  Uint32 h;
+
+  if (!surf)
+    return;
+
+  h = text_cache_hash(t, size, col, outline);
+  e = text_cache_find(h, t, size, col, outline);
+  if (e)
+    text_cache_remove(e);
+
+  e = malloc(sizeof(text_cache_entry));
+  if (!e)
+    return;
+  e->text = strdup(t);
+  if (!e->text)
+  {
+    free(e);
+    return;
+  }
+
+  strncpy(e->font_name, settings.theme_font_name, FNLEN - 1);
+  e->font_name[FNLEN - 1] = '\0';
+  e->size = size;
+  e->col = *col;
+  e->outline = outline;
+  e->hash = h;
+  e->surf = surf;
+  e->bytes = (unsigned long)surf->pitch * surf->h;
+  surf->refcount++;
+
+  e->hash_next = text_cache[h % TEXT_CACHE_BUCKETS];
+  text_cache[h % TEXT_CACHE_BUCKETS] = e;
+  text_cache_push_mru(e);
+  text_stats.bytes += e->bytes;
+  text_stats.entries++;
+
+  while (text_cache_lru != e
+      && (text_stats.entries > TEXT_CACHE_MAX_ENTRIES
+       || text_stats.bytes > TEXT_CACHE_MAX_BYTES))
+  {
+    text_cache_remove(text_cache_lru);
+    text_stats.evictions++;
+  }
+}
+
+
+/* Empties the text cache. Surfaces still held by callers stay valid: */
+void FlushTextCache(void)
+{
+  DEBUGCODE
+  {
+    fprintf(stderr, "Text cache: %lu hits, %lu misses, %lu evictions, "
+                    "%d entries, %lu bytes\n",
+            text_stats.hits, text_stats.misses, text_stats.evictions,
+            text_stats.entries, text_stats.bytes);
+  }
+
+  while (text_cache_lru)
+    text_cache_remove(text_cache_lru);
+}
+
+
+void GetTextCacheStats(text_cache_stats* stats)
+{
+  if (stats)
+    *stats = text_stats;
+}
+
+
 /* BlackOutline() creates a surface containing text of the designated */
 /* foreground color, surrounded by a black shadow, on a transparent    */
-/* background.  The appearance can be tuned by adjusting the number of */
-/* background copies and the offset where the foreground text is       */
-/* finally written (see below).                                        */
+/* background.  The text is rendered only once - the shadow is made by */
+/* "dilating" the glyph coverage (each shadow pixel takes the maximum  */
+/* coverage within the OUTLINE_* offsets below), and the colored text  */
+/* goes on top at (OUTLINE_TEXT_X, OUTLINE_TEXT_Y).                    */
+/* BlackOutlineSet() makes one such surface for each of 'num_colors'   */
+/* colors from the same rendering, which is much quicker than calling  */
+/* BlackOutline() once per color.                                      */
+
+/* Shadow covers text offsets x = 1-3, y = 1-2 (as the old 6-blit shadow did): */
+#define OUTLINE_X_MIN 1
+#define OUTLINE_X_MAX 3
+#define OUTLINE_Y_MIN 1
+#define OUTLINE_Y_MAX 2
+#define OUTLINE_TEXT_X 1
+#define OUTLINE_TEXT_Y 1
+#define OUTLINE_BORDER 5
+
+static SDL_Surface* render_text_coverage(const char* t, int font_size);
+static SDL_Surface* create_display_alpha_surface(int w, int h);
+
 //SDL_Surface* BlackOutline(const char *t, TTF_Font *font, SDL_Color *c)
 SDL_Surface* BlackOutline(const char* t, int font_size, const SDL_Color* c)
 {
   SDL_Surface* out = NULL;
-  SDL_Surface* black_letters = NULL;
-  SDL_Surface* white_letters = NULL;
-  SDL_Surface* bg = NULL;
-  SDL_Rect dstrect;
-  Uint32 color_key;
 
-/* Make sure everything is sane before we proceed: */
-#ifdef HAVE_LIBSDL_PANGO
-  if (!context)
-  {
-    fprintf(stderr, "BlackOutline(): invalid SDL_Pango context - returning.\n");
+  if (!BlackOutlineSet(t, font_size, c, 1, &out))
     return NULL;
-  }
-#else
-  TTF_Font* font = get_font(font_size);
-  if (!font)
-  {
-    fprintf(stderr, "BlackOutline(): could not load needed font - returning.\n");
-    return NULL;
-  }
-#endif
 
-  if (!t || !c)
+  return out;
+}
+
+
+/* Fills out[0] through out[num_colors - 1] with outlined text in each */
+/* of the colors c[]. Returns 1 on success, 0 on failure (in which     */
+/* case all of out[] are NULL):                                        */
+int BlackOutlineSet(const char* t, int font_size, const SDL_Color* c,
+                    int num_colors, SDL_Surface** out)
+{
+  SDL_Surface* letters = NULL;
+  SDL_PixelFormat* lf;
+  Uint8 *cov = NULL, *wide = NULL, *alpha = NULL, *weight = NULL;
+  int w, h, out_w, out_h;
+  int x, y, k, ok = 1;
+
+  if (!t || !c || !out || num_colors < 1)
   {
-    fprintf(stderr, "BlackOutline(): invalid ptr parameter, returning.\n");
-    return NULL;
+    fprintf(stderr, "BlackOutlineSet(): invalid ptr parameter, returning.\n");
+    return 0;
   }
 
+  for (k = 0; k < num_colors; k++)
+    out[k] = NULL;
+
   if (t[0] == '\0')
   {
-    LOG("BlackOutline(): empty string, returning\n");
-    return NULL;
+    LOG("BlackOutlineSet(): empty string, returning\n");
+    return 0;
   }
 
 DEBUGCODE
 {
-  fprintf( stderr, "\nEntering BlackOutline(): \n");
-  fprintf( stderr, "BlackOutline of \"%s\"\n", t );
+  fprintf( stderr, "\nEntering BlackOutlineSet(): \n");
+  fprintf( stderr, "BlackOutlineSet of \"%s\", %d colors\n", t, num_colors );
 }
 
-#ifdef HAVE_LIBSDL_PANGO
-  Set_SDL_Pango_Font_Size(font_size);
-  SDLPango_SetDefaultColor(context, MATRIX_TRANSPARENT_BACK_BLACK_LETTER);
-  SDLPango_SetText(context, t, -1);
-  black_letters = SDLPango_CreateSurfaceDraw(context);
-#else
-  black_letters = TTF_RenderUTF8_Blended(font, t, black);
-#endif
+  /* Use whatever is cached, and only render the colors that missed: */
+  for (k = 0; k < num_colors; k++)
+    if (!(out[k] = text_cache_get(t, font_size, &c[k], 1)))
+      ok = 0;
+  if (ok)
+    return 1;
+  ok = 1;
 
-  if (!black_letters)
+  letters = render_text_coverage(t, font_size);
+  if (!letters)
   {
-    fprintf (stderr, "Warning - BlackOutline() could not create image for %s\n", t);
-    return NULL;
+    fprintf (stderr, "Warning - BlackOutlineSet() could not create image for %s\n", t);
+    ok = 0;
+    goto done;
   }
 
-  bg = SDL_CreateRGBSurface(SDL_SWSURFACE,
-                            (black_letters->w) + 5,
-                            (black_letters->h) + 5,
-                             32,
-                             rmask, gmask, bmask, amask);
-  /* Use color key for eventual transparency: */
-  color_key = SDL_MapRGB(bg->format, 01, 01, 01);
-  SDL_FillRect(bg, NULL, color_key);
-
-  /* Now draw black outline/shadow 2 pixels on each side: */
-  dstrect.w = black_letters->w;
-  dstrect.h = black_letters->h;
+  lf = letters->format;
+  if (lf->BytesPerPixel != 4 || !lf->Amask)
+  {
+    fprintf(stderr, "BlackOutlineSet(): rendered text has no alpha channel\n");
+    SDL_FreeSurface(letters);
+    ok = 0;
+    goto done;
+  }
 
-  /* NOTE: can make the "shadow" more or less pronounced by */
-  /* changing the parameters of these loops.                */
-  for (dstrect.x = 1; dstrect.x < 4; dstrect.x++)
-    for (dstrect.y = 1; dstrect.y < 3; dstrect.y++)
-      SDL_BlitSurface(black_letters , NULL, bg, &dstrect );
+  w = letters->w;
+  h = letters->h;
+  out_w = w + OUTLINE_BORDER;
+  out_h = h + OUTLINE_BORDER;
 
-  SDL_FreeSurface(black_letters);
+  cov = calloc(out_w * out_h, 1);
+  wide = calloc(out_w * out_h, 1);
+  alpha = malloc(out_w * out_h);
+  weight = malloc(out_w * out_h);
+  if (!cov || !wide || !alpha || !weight)
+  {
+    fprintf(stderr, "BlackOutlineSet(): out of memory\n");
+    ok = 0;
+    goto done;
+  }
 
-  /* --- Put the color version of the text on top! --- */
-#ifdef HAVE_LIBSDL_PANGO
-  /* convert color arg: */
-  SDLPango_Matrix* color_matrix = SDL_Colour_to_SDLPango_Matrix(c);
+  /* Glyph coverage, from the alpha channel of the rendered text: */
+  SDL_LockSurface(letters);
+  for (y = 0; y < h; y++)
+  {
+    Uint32* p = (Uint32*)((Uint8*)letters->pixels + y * letters->pitch);
+    for (x = 0; x < w; x++)
+      cov[y * out_w + x] = (p[x] & lf->Amask) >> lf->Ashift;
+  }
+  SDL_UnlockSurface(letters);
+  SDL_FreeSurface(letters);
 
-  if (color_matrix)
+  /* Dilate: horizontal maximum into wide[], then vertical maximum - */
+  /* the shadow at (x, y) is the strongest text coverage at any of   */
+  /* (x - dx, y - dy) for the offsets dx, dy given above:            */
+  for (y = 0; y < h; y++)
   {
-    SDLPango_SetDefaultColor(context, color_matrix);
-    free(color_matrix);
+    for (x = 0; x < out_w; x++)
+    {
+      Uint8 m = 0;
+      int dx;
+      for (dx = OUTLINE_X_MIN; dx <= OUTLINE_X_MAX; dx++)
+        if (x - dx >= 0 && x - dx < w && cov[y * out_w + x - dx] > m)
+          m = cov[y * out_w + x - dx];
+      wide[y * out_w + x] = m;
+    }
   }
-  else  /* fall back to just using white if conversion fails: */
-    SDLPango_SetDefaultColor(context, MATRIX_TRANSPARENT_BACK_WHITE_LETTER);
 
-  white_letters = SDLPango_CreateSurfaceDraw(context);
+  /* Vertical pass, then composite the text over the black shadow. */
+  /* alpha[] is the final opacity and weight[] the share of it     */
+  /* that is text color rather than black (both 0-255):            */
+  for (y = 0; y < out_h; y++)
+  {
+    for (x = 0; x < out_w; x++)
+    {
+      Uint32 s = 0, f = 0, a;
+      int dy, i = y * out_w + x;
 
-#else
-  white_letters = TTF_RenderUTF8_Blended(font, t, *c);
-#endif
+      for (dy = OUTLINE_Y_MIN; dy <= OUTLINE_Y_MAX; dy++)
+        if (y - dy >= 0 && y - dy < h && wide[(y - dy) * out_w + x] > s)
+          s = wide[(y - dy) * out_w + x];
+
+      if (x >= OUTLINE_TEXT_X && y >= OUTLINE_TEXT_Y
+       && x - OUTLINE_TEXT_X < w && y - OUTLINE_TEXT_Y < h)
+        f = cov[(y - OUTLINE_TEXT_Y) * out_w + x - OUTLINE_TEXT_X];
+
+      a = f + s * (255 - f) / 255;
+      alpha[i] = a;
+      weight[i] = a ? (f * 255 + a / 2) / a : 0;
+    }
+  }
 
-  if (!white_letters)
+  /* One output surface per missing color, made in display format: */
+  for (k = 0; k < num_colors; k++)
   {
-    fprintf (stderr, "Warning - BlackOutline() could not create image for %s\n", t);
-    return NULL;
+    SDL_Surface* s;
+    SDL_PixelFormat* f;
+
+    if (out[k])
+      continue;
+    s = create_display_alpha_surface(out_w, out_h);
+    if (!s)
+    {
+      ok = 0;
+      break;
+    }
+
+    f = s->format;
+    SDL_LockSurface(s);
+    for (y = 0; y < out_h; y++)
+    {
+      Uint32* p = (Uint32*)((Uint8*)s->pixels + y * s->pitch);
+      for (x = 0; x < out_w; x++)
+      {
+        int i = y * out_w + x;
+        Uint32 wt = weight[i];
+
+        p[x] = (((c[k].r * wt + 127) / 255) << f->Rshift)
+             | (((c[k].g * wt + 127) / 255) << f->Gshift)
+             | (((c[k].b * wt + 127) / 255) << f->Bshift)
+             | ((Uint32)alpha[i] << f->Ashift);
+      }
+    }
+    SDL_UnlockSurface(s);
+    out[k] = s;
+    text_cache_put(t, font_size, &c[k], 1, s);
   }
 
-  dstrect.x = 1;
-  dstrect.y = 1;
-  SDL_BlitSurface(white_letters, NULL, bg, &dstrect);
-  SDL_FreeSurface(white_letters);
+done:
+  free(cov);
+  free(wide);
+  free(alpha);
+  free(weight);
 
-  /* --- Convert to the screen format for quicker blits --- */
-  SDL_SetColorKey(bg, SDL_SRCCOLORKEY|SDL_RLEACCEL, color_key);
-  out = SDL_DisplayFormatAlpha(bg);
-  SDL_FreeSurface(bg);
+  if (!ok)
+  {
+    for (k = 0; k < num_colors; k++)
+    {
+      if (out[k])
+        SDL_FreeSurface(out[k]);
+      out[k] = NULL;
+    }
+  }
 
 DEBUGCODE
-  { fprintf( stderr, "\nLeaving BlackOutline(): \n"); }
-
+  { fprintf( stderr, "\nLeaving BlackOutlineSet(): \n"); }
 
-  return out;
+  return ok;
 }
 
 
 
 SDL_Surface* BlackOutline_w(const wchar_t* t, int font_size, const SDL_Color* c, int length)
+{
+  SDL_Surface* out = NULL;
+
+  if (!BlackOutlineSet_w(t, font_size, c, 1, &out, length))
+    return NULL;
+
+  return out;
+}
+
+
+int BlackOutlineSet_w(const wchar_t* t, int font_size, const SDL_Color* c,
+                      int num_colors, SDL_Surface** out, int length)
 {
   wchar_t wchar_tmp[1024];
   char tmp[1024];
-  int i;
+  int i, k;
+
+  /* Callers may not check the return value, so never leave out[] unset: */
+  if (out)
+    for (k = 0; k < num_colors; k++)
+      out[k] = NULL;
 
   // Safety checks:
-  if (!t || !c)
+  if (!t || !c || !out)
   {
-    fprintf(stderr, "BlackOutline_w(): invalid ptr parameter, returning.\n");
-    return NULL;
+    fprintf(stderr, "BlackOutlineSet_w(): invalid ptr parameter, returning.\n");
+    return 0;
   }
 
   if (t[0] == '\0')
   {
-    fprintf(stderr, "BlackOutline_w(): empty string, returning\n");
-    return NULL;
+    fprintf(stderr, "BlackOutlineSet_w(): empty string, returning\n");
+    return 0;
   }
 
+  if (length < 0 || length > 1023)
+    length = 1023;
   wcsncpy(wchar_tmp, t, length);
   wchar_tmp[length] = '\0';
 
   DEBUGCODE
   {
-    fprintf(stderr, "In BlackOutline_w() - input wchar_t string is: %S\n", wchar_tmp);
+    fprintf(stderr, "In BlackOutlineSet_w() - input wchar_t string is: %S\n", wchar_tmp);
   }
 
   i = ConvertToUTF8(wchar_tmp, tmp, 1024);
@@ -1394,10 +2566,10 @@ SDL_Surface* BlackOutline_w(const wchar_t* t, int font_size, const SDL_Color* c,
 
   DEBUGCODE
   {
-    fprintf(stderr, "In BlackOutline_w() - converted UTF8 string is: %s\n", tmp);
+    fprintf(stderr, "In BlackOutlineSet_w() - converted UTF8 string is: %s\n", tmp);
   }
 
-  return BlackOutline(tmp, font_size, c);
+  return BlackOutlineSet(tmp, font_size, c, num_colors, out);
 }
 
 /* This (fast) function just returns a non-outlined surf */
@@ -1409,6 +2581,10 @@ SDL_Surface* SimpleText(const char *t, int size, const SDL_Color* col)
   if (!t||!col)
     return NULL;
 
+  surf = text_cache_get(t, size, col, 0);
+  if (surf)
+    return surf;
+
 #ifdef HAVE_LIBSDL_PANGO
   if (!context)
   {
@@ -1439,16 +2615,141 @@ SDL_Surface* SimpleText(const char *t, int size, const SDL_Color* col)
   }
 #endif
 
+  text_cache_put(t, size, col, 0, surf);
+
   return surf;
 }
 
 
+/* TextExtents() gives the size in pixels that 't' would have if drawn  */
+/* with SimpleText() in 'font_size', without rendering anything.        */
+/* Returns 1 on success, 0 on failure:                                  */
+int TextExtents(const char* t, int font_size, int* w, int* h)
+{
+  int tw = 0, th = 0;
+
+  if (!t)
+    return 0;
+
+#ifdef HAVE_LIBSDL_PANGO
+  if (!context || !Set_SDL_Pango_Font_Size(font_size))
+  {
+    fprintf(stderr, "TextExtents() - context not valid!\n");
+    return 0;
+  }
+  SDLPango_SetText(context, t, -1);
+  tw = SDLPango_GetLayoutWidth(context);
+  th = SDLPango_GetLayoutHeight(context);
+#else
+  {
+    TTF_Font* font = get_font(font_size);
+    if (!font || TTF_SizeUTF8(font, t, &tw, &th) < 0)
+      return 0;
+  }
+#endif
+
+  if (w)
+    *w = tw;
+  if (h)
+    *h = th;
+  return 1;
+}
+
+
+/* Width in pixels of 't' in 'font_size', or -1 on error: */
+int TextWidth(const char* t, int font_size)
+{
+  int w;
+
+  if (!TextExtents(t, font_size, &w, NULL))
+    return -1;
+  return w;
+}
+
+
+/* Width in pixels of the first 'length' chars of 't' (all of it if    */
+/* 'length' is negative), or -1 on error. The prefix is measured as a  */
+/* whole so shaping (combining marks, conjuncts, kerning) is counted:  */
+int TextWidth_w(const wchar_t* t, int length, int font_size)
+{
+  wchar_t wchar_tmp[1024];
+  char tmp[1024];
+
+  if (!t)
+    return -1;
+
+  if (length < 0 || length > 1023)
+    length = 1023;
+  wcsncpy(wchar_tmp, t, length);
+  wchar_tmp[length] = '\0';
+
+  ConvertToUTF8(wchar_tmp, tmp, 1024);
+  if (tmp[0] == '\0')
+    return 0;
+  return TextWidth(tmp, font_size);
+}
+
+
 /*-----------------------------------------------------------*/
 /* Local functions, callable only within SDL_extras, divided */
 /* according with which text lib we are using:               */
 /*-----------------------------------------------------------*/
 
 
+/* Renders 't' in white on a transparent background - the alpha */
+/* channel of the result is the glyph coverage:                 */
+static SDL_Surface* render_text_coverage(const char* t, int font_size)
+{
+#ifdef HAVE_LIBSDL_PANGO
+  if (!context)
+  {
+    fprintf(stderr, "render_text_coverage(): invalid SDL_Pango context\n");
+    return NULL;
+  }
+  Set_SDL_Pango_Font_Size(font_size);
+  SDLPango_SetDefaultColor(context, MATRIX_TRANSPARENT_BACK_WHITE_LETTER);
+  SDLPango_SetText(context, t, -1);
+  return SDLPango_CreateSurfaceDraw(context);
+#else
+  TTF_Font* font = get_font(font_size);
+  if (!font)
+  {
+    fprintf(stderr, "render_text_coverage(): could not load needed font\n");
+    return NULL;
+  }
+  return TTF_RenderUTF8_Blended(font, t, white);
+#endif
+}
+
+
+/* Creates a 32 bpp RGBA surface in the format SDL_DisplayFormatAlpha() */
+/* would give, so it can be filled in directly without a conversion:    */
+static SDL_Surface* create_display_alpha_surface(int w, int h)
+{
+  SDL_PixelFormat* vf = screen ? screen->format : NULL;
+  Uint32 r_mask = 0x00ff0000, b_mask = 0x000000ff;
+  SDL_Surface* s;
+
+  /* Same rule as SDL_DisplayFormatAlpha() for BGR screens: */
+  if (vf)
+  {
+    if ((vf->BytesPerPixel == 2 && vf->Rmask == 0x1f
+         && (vf->Bmask == 0xf800 || vf->Bmask == 0x7c00))
+     || (vf->BytesPerPixel > 2 && vf->Rmask == 0xff && vf->Bmask == 0xff0000))
+    {
+      r_mask = 0x000000ff;
+      b_mask = 0x00ff0000;
+    }
+  }
+
+  s = SDL_CreateRGBSurface(SDL_SWSURFACE, w, h, 32,
+                           r_mask, 0x0000ff00, b_mask, 0xff000000);
+  if (!s)
+    fprintf(stderr, "create_display_alpha_surface(): %s\n", SDL_GetError());
+  return s;
+}
+
+
 
 #ifdef HAVE_LIBSDL_PANGO
 
@@ -1457,41 +2758,77 @@ SDL_Surface* SimpleText(const char *t, int size, const SDL_Color* col)
 /* NOTE the scaling by 3/4 a few lines down represents a conversion from      */
 /* the usual text dpi of 72 to the typical screen dpi of 96. It gives         */
 /* font sizes fairly similar to a SDL_ttf font with the same numerical value. */
+/* Contexts are kept in context_pool[] once made (like font_list[] for        */
+/* SDL_ttf), so switching between a few sizes is just a lookup. If the pool   */
+/* is full, the least recently used context is freed to make room.            */
 static int Set_SDL_Pango_Font_Size(int size)
 {
-  /* static so we can "remember" values from previous time through: */
-  static int prev_pango_font_size;
-  static char prev_font_name[FNLEN];
+  static unsigned long use_count = 0;
+  pango_pool_entry* slot = NULL;
+  char buf[64];
+  int i;
+
   /* Do nothing unless we need to change size or font: */
-  if ((size == prev_pango_font_size)
-      &&
-      (0 == strncmp(prev_font_name, settings.theme_font_name, sizeof(prev_font_name))))
-    return 1;
-  else
+  for (i = 0; i < PANGO_CONTEXT_POOL_SIZE; i++)
   {
-    char buf[64];
-    DEBUGCODE { fprintf(stderr, "Setting font size to %d\n", size); }
-    if(context != NULL)
-      SDLPango_FreeContext(context);
-    context = NULL;
-    snprintf(buf, sizeof(buf), "%s %d", settings.theme_font_name, (int)((size * 3)/4));
+    pango_pool_entry* p = &context_pool[i];
+
+    if (p->context && p->size == size
+     && 0 == strncmp(p->font_name, settings.theme_font_name, FNLEN))
+    {
+      p->last_used = ++use_count;
+      context = p->context;
+      return 1;
+    }
+    /* Remember an empty slot, or else the least recently used one: */
+    if (!slot || (slot->context && (!p->context || p->last_used < slot->last_used)))
+      slot = p;
+  }
+
+  DEBUGCODE { fprintf(stderr, "Setting font size to %d\n", size); }
+
+  if (slot->context)
+  {
+    if (context == slot->context)
+      context = NULL;
+    SDLPango_FreeContext(slot->context);
+    slot->context = NULL;
+  }
+
+  snprintf(buf, sizeof(buf), "%s %d", settings.theme_font_name, (int)((size * 3)/4));
 #ifdef HAVE_SDLPANGO_CREATECONTEXT_GIVENFONTDESC
-    context =  SDLPango_CreateContext_GivenFontDesc(buf);
+  slot->context = SDLPango_CreateContext_GivenFontDesc(buf);
 #else
-    fprintf(stderr, "SDL_Pango version is missing needed function:\n"
-		    "SDLPango_CreateContext_GivenFontDesc()\n"
-		    "Will not be able to set font size.\n");
-#endif    
-  }
+  fprintf(stderr, "SDL_Pango version is missing needed function:\n"
+		  "SDLPango_CreateContext_GivenFontDesc()\n"
+		  "Will not be able to set font size.\n");
+#endif
 
-  if (!context)
+  if (!slot->context)
+  {
+    context = NULL;
     return 0;
-  else
+  }
+
+  slot->size = size;
+  strncpy(slot->font_name, settings.theme_font_name, FNLEN - 1);
+  slot->font_name[FNLEN - 1] = '\0';
+  slot->last_used = ++use_count;
+  context = slot->context;
+  return 1;
+}
+
+
+static void free_context_pool(void)
+{
+  int i;
+  for (i = 0; i < PANGO_CONTEXT_POOL_SIZE; i++)
   {
-    prev_pango_font_size = size;
-    strncpy(prev_font_name, settings.theme_font_name, sizeof(prev_font_name));
-    return 1;
+    if (context_pool[i].context)
+      SDLPango_FreeContext(context_pool[i].context);
+    context_pool[i].context = NULL;
   }
+  context = NULL;
 }
 
 
@@ -67,14 +67,28 @@ static const SDL_Color yellow 		= {0xff, 0xff, 0x00, 0x00};
 #define ERASE_MARGIN 5
 
 
-typedef struct {
+typedef struct sprite_s {
   SDL_Surface* frame[MAX_SPRITE_FRAMES];
   SDL_Surface* default_img;
   int num_frames;
   int cur;
+  /* For sprites made by FlipSprite(): frames are mirrored from */
+  /* 'flip_src' the first time they are needed (see SpriteFrame()): */
+  struct sprite_s* flip_src;
+  int flip_x, flip_y;
 } sprite;
 
 
+/* Counters for the rendered-text cache behind BlackOutline()/SimpleText(): */
+typedef struct {
+  unsigned long hits;
+  unsigned long misses;
+  unsigned long evictions;
+  unsigned long bytes;
+  int entries;
+} text_cache_stats;
+
+
 /* "Public" function prototypes: */
 void DrawButton(SDL_Rect* target_rect, int radius, Uint8 r, Uint8 g, Uint8 b, Uint8 a);
 void RoundCorners(SDL_Surface* s, Uint16 radius);
@@ -84,25 +98,40 @@ void DarkenScreen(Uint8 bits);
 void SwitchScreenMode(void);
 int WaitForKeypress(void);
 SDL_Surface* Blend(SDL_Surface *S1, SDL_Surface *S2, float gamma);
+int BlendInto(SDL_Surface* dst, SDL_Surface* S1, SDL_Surface* S2, float gamma);
+int BlitOntoAlpha(SDL_Surface* src, SDL_Surface* dst, int x, int y);
 SDL_Surface* zoom(SDL_Surface * src, int new_w, int new_h);
+SDL_Surface* zoom_serial(SDL_Surface* src, int new_w, int new_h);
+void InitZoomThreads(void);
+void FreeZoomThreads(void);
 int TransWipe(const SDL_Surface* newbkg, int type, int segments, int duration);
 
 /* Blit queue functions: */
 void InitBlitQueue(void);
 void ResetBlitQueue(void);
+void FreeBlitQueue(void);
 int AddRect(SDL_Rect* src, SDL_Rect* dst);
 int DrawObject(SDL_Surface* surf, int x, int y);
+SDL_Surface* SpriteFrame(sprite* gfx, int n);
 int DrawSprite(sprite* gfx, int x, int y);
 int EraseObject(SDL_Surface* surf, int x, int y);
 int EraseSprite(sprite* img, int x, int y);
 void UpdateScreen(int* frame);
+int MergeRects(SDL_Rect* rects, int n);
 
 /*Text rendering functions: */
 int Setup_SDL_Text(void);
 void Cleanup_SDL_Text(void);
 SDL_Surface* BlackOutline(const char* t, int font_size, const SDL_Color* c);
 SDL_Surface* BlackOutline_w(const wchar_t* t, int font_size, const SDL_Color* c, int length);
+int BlackOutlineSet(const char* t, int font_size, const SDL_Color* c, int num_colors, SDL_Surface** out);
+int BlackOutlineSet_w(const wchar_t* t, int font_size, const SDL_Color* c, int num_colors, SDL_Surface** out, int length);
 SDL_Surface* SimpleText(const char *t, int size, const SDL_Color* col);
+int TextExtents(const char* t, int font_size, int* w, int* h);
+int TextWidth(const char* t, int font_size);
+int TextWidth_w(const wchar_t* t, int length, int font_size);
+void FlushTextCache(void);
+void GetTextCacheStats(text_cache_stats* stats);
 //SDL_Surface* SimpleTextWithOffset(const char *t, int size, SDL_Color* col, int *glyph_offset);
 
 #endif
@@ -45,6 +45,22 @@ typedef struct uni_glyph {
 /* These are the arrays for the red and white letters: */
 static uni_glyph char_glyphs[MAX_UNICODES] = {{0, NULL, NULL}};
 
+/* Open-addressed hash table mapping a Unicode value to its position in an  */
+/* array such as char_glyphs[], so lookups don't need to walk the array.    */
+/* The table has twice as many slots as MAX_UNICODES so it is never more    */
+/* than half full and probe sequences stay very short.                      */
+#define UNI_INDEX_BITS  11
+#define UNI_INDEX_SIZE  (1 << UNI_INDEX_BITS)
+
+typedef struct uni_index {
+  wchar_t key[UNI_INDEX_SIZE];
+  short val[UNI_INDEX_SIZE];    /* position + 1, so 0 means slot is empty */
+  int count;
+} uni_index;
+
+/* Index into char_glyphs[], rebuilt by RenderLetters(): */
+static uni_index glyph_index;
+
 /* An individual item in the list of unicode characters in the keyboard setup.   */
 /* Basically, just the Unicode value for the key and the finger used to type it. */
 /*typedef struct keymap {
@@ -64,19 +80,49 @@ typedef struct kbd_char {
 /* Unicode value of the key and the associated fingering.                     */
 static kbd_char keyboard_list[MAX_UNICODES] = {{0, -1, {0}, 0, -1}};
 
+/* Index into keyboard_list[], rebuilt by LoadKeyboard(): */
+static uni_index key_index;
+
 /* Used for word list functions (see below): */
+/* All words are packed one after another, null-terminated, in one     */
+/* growable buffer; word_offset[i] is where word i starts.  Pointers    */
+/* into the arena stay valid until the list is cleared or regenerated. */
 static int num_words;
-static wchar_t word_list[MAX_NUM_WORDS][MAX_WORD_SIZE + 1];
+static int words_cap = 0;
+static int* word_offset = NULL;
+static wchar_t* word_arena = NULL;
+static size_t arena_len = 0;
+static size_t arena_cap = 0;
+
+/* Word selection index, rebuilt by GenerateWordList(): words_by_len[] */
+/* holds the word indices sorted by length, with the words of length L */
+/* at positions len_start[L] up to len_start[L + 1], so "length <= n"  */
+/* is simply the first len_start[n + 1] entries.  Each length's run is */
+/* also a shuffle bag: bag_pos[L] words of it have been handed out.    */
+static int* word_len = NULL;
+static int* words_by_len = NULL;
+static int len_start[FNLEN + 1];
+static int bag_pos[FNLEN];
+static int max_word_len = 0;
+static int last_word = -1;
 static wchar_t char_list[MAX_UNICODES];  // List of distinct letters in word list
 static int num_chars_used = 0;       // Number of different letters in word list
+static uni_index char_list_index;    // Index into char_list[]
 
 /* Local function prototypes: */
 static void gen_char_list(void);
+static void build_word_index(void);
+static int add_word(const wchar_t* word, int len);
+static void free_word_list(void);
+static int next_from_bag(int len);
 static int add_char(wchar_t uc);
 //static void set_letters(signed char* t);
 //static void show_letters(void);
 static void clear_keyboard(void);
 static int unicode_in_key_list(wchar_t uni_char);
+static void uni_index_clear(uni_index* ix);
+static int uni_index_add(uni_index* ix, wchar_t uc, int val);
+static int uni_index_find(const uni_index* ix, wchar_t uc);
 int check_needed_unicodes_str(const wchar_t* s);
 int map_keys(wchar_t wide_char, kbd_char* keyboard_entry);
 
@@ -176,6 +222,7 @@ int LoadKeyboard(void)
 
         /* Just plug values into array: */
         keyboard_list[k].unicode_value = wide_str[2];
+        uni_index_add(&key_index, wide_str[2], k);
         keyboard_list[k].finger = wcstol(&wide_str[0], NULL, 0);
 
         if (wcslen(wide_str) < 5)
@@ -201,8 +248,9 @@ int LoadKeyboard(void)
       }
       else
       {
-        if(wcslen(wide_str) == 1)
+        if(wcslen(wide_str) == 1 && k < MAX_UNICODES)
         {
+          uni_index_add(&key_index, wide_str[0], k);
           if(!settings.use_english)
           {
             keyboard_list[k].unicode_value = wide_str[0];
@@ -268,15 +316,9 @@ int GetShift(int i)
 
 int GetIndex(wchar_t uni_char)
 {
-  int i = 0;
-
-  while ((i < MAX_UNICODES)
-     &&  (keyboard_list[i].unicode_value != uni_char))
-  {
-    i++;
-  }
+  int i = uni_index_find(&key_index, uni_char);
 
-  if (i == MAX_UNICODES)
+  if (i < 0)
   {
     fprintf(stderr, "GetIndex - Unicode char '%C' not found in list.\n", uni_char);
     return -1;
@@ -341,16 +383,7 @@ wchar_t GetLastKey()
 
 int unicode_in_key_list(wchar_t uni_char)
 {
-  int i = 0;
-  while ((i < MAX_UNICODES)
-     &&  (keyboard_list[i].unicode_value != uni_char))
-  {
-    i++;
-  }
-  if (i == MAX_UNICODES)
-    return 0;
-  else
-    return 1;
+  return (uni_index_find(&key_index, uni_char) >= 0);
 }
 
 
@@ -443,14 +476,8 @@ wchar_t GetRandLetter(void)
  */
 void ClearWordList(void)
 {
-  int i;
-//  for (i = 0; i < num_words; i++)
-  //more robust if we just zero entire list - takes neglible time
-  for (i = 0; i < MAX_NUM_WORDS; i++)
-  {
-    word_list[i][0] = '\0';
-  }
-  num_words = 0;
+  free_word_list();
+  build_word_index();
 }
 
 
@@ -460,37 +487,53 @@ void ClearWordList(void)
  */
 wchar_t* GetWord(void)
 {
-  static int last_choice = -1;
-  int choice;
+  return GetWordMaxLen(max_word_len);
+}
 
-  LOG("Entering GetWord()\n");
 
-  /* Safety/sanity checks: */
-  /* Count list to make sure num_words is correct: */
-  num_words = 0;
-  while (word_list[num_words][0] != '\0')
-  {
-    num_words++;
-  }
 
-  if (0 == num_words)
+/* GetWordMaxLen: like GetWord(), but only picks words of at most
+ * max_len characters.  Returns NULL if there are none.  A length is
+ * picked in proportion to how many words it has, then the next word
+ * is drawn from that length's shuffle bag, so every word comes up
+ * once before any repeats.
+ */
+wchar_t* GetWordMaxLen(int max_len)
+{
+  int count, choice, pos, len;
+
+  LOG("Entering GetWordMaxLen()\n");
+
+  if (max_len > max_word_len)
+    max_len = max_word_len;
+  count = (max_len > 0) ? len_start[max_len + 1] : 0;
+
+  if (0 == count)
   {
-    LOG("No words in list\n");
+    LOG("No words in list short enough\n");
     return NULL;
   }
 
   /* Now pick one: */
-  do
+  pos = rand() % count;
+  len = word_len[words_by_len[pos]];
+  if (count > 1
+   && len_start[len + 1] - len_start[len] == 1
+   && words_by_len[len_start[len]] == last_word)
   {
-    choice = (rand() % num_words);
-  } while ((choice == last_choice) || (num_words < 2));
-
-  last_choice = choice;
+    /* Only word of its length was just used - pick from the others */
+    pos = rand() % (count - 1);
+    if (pos >= len_start[len])
+      pos++;
+    len = word_len[words_by_len[pos]];
+  }
+  choice = next_from_bag(len);
+  last_word = choice;
 
   /* NOTE need %S rather than %s because of wide characters */
-  DEBUGCODE { fprintf(stderr, "Selected word is: %S\n", word_list[choice]); }
+  DEBUGCODE { fprintf(stderr, "Selected word is: %S\n", word_arena + word_offset[choice]); }
 
-  return word_list[choice];
+  return word_arena + word_offset[choice];
 }
 
 
@@ -514,7 +557,7 @@ int GenerateWordList(const char* wordFn)
 
   DEBUGCODE { fprintf(stderr, "Entering GenerateWordList() for file: %s\n", wordFn); }
 
-  num_words = 0;
+  free_word_list();
 
   /* --- open the file --- */
   wordFile = fopen( wordFn, "r" );
@@ -531,7 +574,7 @@ int GenerateWordList(const char* wordFn)
   /* (compiler complains unless we inspect return value) */
   ret = fscanf( wordFile, "%[^\n]\n", temp_word);
 
-  while (!feof(wordFile) && (num_words < MAX_NUM_WORDS))
+  while (!feof(wordFile))
   {
     ret = fscanf( wordFile, "%[^\n]\n", temp_word);
     DEBUGCODE {fprintf(stderr, "temp_word = %s\n", temp_word);}
@@ -547,7 +590,7 @@ int GenerateWordList(const char* wordFn)
     }
 
     /* Convert from UTF-8 to wcs and make sure word is usable: */
-    length = ConvertFromUTF8(temp_wide_word, temp_word, FNLEN);
+    length = ConvertFromUTF8Strict(temp_wide_word, temp_word, FNLEN);
 
     DOUT(length);
 
@@ -573,13 +616,6 @@ int GenerateWordList(const char* wordFn)
 //       continue;
 //     }
 
-    if (num_words >= MAX_NUM_WORDS)
-    {
-      fprintf(stderr, "Word '%s' not added - list has reached max of %d characters\n",
-              temp_word, MAX_NUM_WORDS);
-      continue;
-    }
-
     if (!check_needed_unicodes_str(temp_wide_word))
     {
       fprintf(stderr, "Word '%S' not added - contains Unicode chars not in keyboard list\n",
@@ -588,19 +624,14 @@ int GenerateWordList(const char* wordFn)
     }
 
     /* If we make it to here, OK to add word: */
-    /* NOTE we have to add one to the length argument */
-    /* to include the terminating null.  */
     DEBUGCODE
     {
       fprintf(stderr, "Adding word: %ls\n", temp_wide_word);
     }
 
-    wcsncpy(word_list[num_words], temp_wide_word, strlen(temp_word) + 1);
-    num_words++;
+    if (!add_word(temp_wide_word, length))
+      break;
   }
-        
-  /* Make sure list is terminated with null character */
-  word_list[num_words][0] = '\0';
 
   DOUT(num_words);
 
@@ -612,6 +643,7 @@ int GenerateWordList(const char* wordFn)
   /* Make list of all unicode characters used in word list: */
   /* (we use this to check to make sure all are "typable"); */
   gen_char_list();
+  build_word_index();
 
   LOG("Leaving GenerateWordList()\n");
 
@@ -626,6 +658,7 @@ int RenderLetters(int font_size)
   int i, j;  /* i is chars attempted, j is chars actually rendered. */
 
   i = j = num_chars_used = 0;
+  uni_index_clear(&glyph_index);
 
   t[1] = '\0';
 
@@ -641,8 +674,19 @@ int RenderLetters(int font_size)
       }
 
       char_glyphs[j].unicode_value = t[0];
-      char_glyphs[j].white_glyph = BlackOutline_w(t, font_size, &white, 1);
-      char_glyphs[j].red_glyph = BlackOutline_w(t, font_size, &red, 1);
+      {
+        /* Both colors from a single rendering of the glyph: */
+        SDL_Color colors[2];
+        SDL_Surface* glyphs[2] = {NULL, NULL};
+
+        colors[0] = white;
+        colors[1] = red;
+        if (!BlackOutlineSet_w(t, font_size, colors, 2, glyphs, 1))
+          fprintf(stderr, "RenderLetters() - could not render '%lc'\n", t[0]);
+        char_glyphs[j].white_glyph = glyphs[0];
+        char_glyphs[j].red_glyph = glyphs[1];
+      }
+      uni_index_add(&glyph_index, t[0], j);
 
       j++;
       num_chars_used++;
@@ -677,20 +721,15 @@ void FreeLetters(void)
   } 
   /* List now empty: */
   num_chars_used = 0;
+  uni_index_clear(&glyph_index);
 }
 
 
 SDL_Surface* GetWhiteGlyph(wchar_t t)
 {
-  int i;
-
-  for (i = 0;
-       (char_glyphs[i].unicode_value != t) && (i <= num_chars_used);
-       i++)
-  {}
+  int i = uni_index_find(&glyph_index, t);
 
-  /* Now return appropriate pointer: */
-  if (i > num_chars_used)
+  if (i < 0)
   {
     /* Didn't find character: */
     fprintf(stderr, "Could not find glyph for Unicode char '%C', value = %d\n", t, t);
@@ -705,15 +744,9 @@ SDL_Surface* GetWhiteGlyph(wchar_t t)
 
 SDL_Surface* GetRedGlyph(wchar_t t)
 {
-  int i;
-
-  for (i = 0;
-       char_glyphs[i].unicode_value != t && i <= num_chars_used;
-       i++)
-  {}
+  int i = uni_index_find(&glyph_index, t);
 
-  /* Now return appropriate pointer: */
-  if (i > num_chars_used)
+  if (i < 0)
   {
     /* Didn't find character: */
     fprintf(stderr, "Could not find glyph for unicode character %lc\n", t);
@@ -755,6 +788,7 @@ int CheckNeededGlyphs(void)
 int check_needed_unicodes_str(const wchar_t* s)
 {
   int i = 0;
+  int len;
 
   if (!s)
   {
@@ -762,7 +796,8 @@ int check_needed_unicodes_str(const wchar_t* s)
     return 0;
   }
 
-  while (i < MAX_WORD_SIZE && i < wcslen(s))
+  len = wcslen(s);
+  while (i < MAX_WORD_SIZE && i < len)
   {
     if (!unicode_in_key_list(s[i]))
     {
@@ -1330,25 +1365,19 @@ void savekeyboard(void)
 
 
 /* Creates a list of distinct Unicode characters in */
-/* word_list[][] (so the program knows what         */
+/* the word list (so the program knows what         */
 /* needs to be rendered for the games)              */
 static void gen_char_list(void)
 {
-  int i, j;
-  i = j = 0;
+  size_t i;
   char_list[0] = '\0';
+  uni_index_clear(&char_list_index);
 
-  while (word_list[i][0] != '\0' && i < MAX_NUM_WORDS) 
+  /* One pass over the packed words, skipping their nulls: */
+  for (i = 0; i < arena_len; i++)
   {
-    j = 0;
-
-    while (word_list[i][j]!= '\0' && j < MAX_WORD_SIZE)
-    {
-      add_char(word_list[i][j]);
-      j++;
-    }
-
-    i++;
+    if (word_arena[i] != '\0')
+      add_char(word_arena[i]);
   }
 
   DEBUGCODE
@@ -1358,10 +1387,145 @@ static void gen_char_list(void)
 }
 
 
+/* Rebuilds the length index used by GetWordMaxLen() with a   */
+/* counting sort, so it is linear in the number of words.     */
+static void build_word_index(void)
+{
+  int i, len;
+
+  memset(len_start, 0, sizeof(len_start));
+  memset(bag_pos, 0, sizeof(bag_pos));
+  max_word_len = 0;
+  last_word = -1;
+
+  /* Count the words of each length (in len_start[len + 1]): */
+  for (i = 0; i < num_words; i++)
+  {
+    len = word_len[i];
+    len_start[len + 1]++;
+    if (len > max_word_len)
+      max_word_len = len;
+  }
+
+  /* Turn counts into starting positions: */
+  for (len = 1; len <= FNLEN; len++)
+    len_start[len] += len_start[len - 1];
+
+  /* Place each word, using bag_pos[] as the fill cursor for now: */
+  for (i = 0; i < num_words; i++)
+  {
+    len = word_len[i];
+    words_by_len[len_start[len] + bag_pos[len]++] = i;
+  }
+
+  /* Mark every bag as used up so the first draw shuffles it: */
+  for (len = 0; len < FNLEN; len++)
+    bag_pos[len] = len_start[len + 1] - len_start[len];
+
+  DEBUGCODE { fprintf(stderr, "build_word_index(): %d words, longest %d\n",
+                      num_words, max_word_len); }
+}
+
+
+/* Appends a word of "len" characters to the arena, growing the */
+/* buffers by doubling so that loading stays linear.  "len" is   */
+/* less than FNLEN, as words are read through FNLEN buffers.     */
+/* Returns 0 if out of memory.                                   */
+static int add_word(const wchar_t* word, int len)
+{
+  int* p;
+  wchar_t* a;
+  size_t new_size;
+
+  if (num_words >= words_cap)
+  {
+    new_size = words_cap ? words_cap * 2 : 256;
+    if (!(p = realloc(word_offset, new_size * sizeof(int))))
+      goto nomem;
+    word_offset = p;
+    if (!(p = realloc(word_len, new_size * sizeof(int))))
+      goto nomem;
+    word_len = p;
+    if (!(p = realloc(words_by_len, new_size * sizeof(int))))
+      goto nomem;
+    words_by_len = p;
+    words_cap = new_size;
+  }
+
+  if (arena_len + len + 1 > arena_cap)
+  {
+    new_size = arena_cap ? arena_cap * 2 : 4096;
+    while (new_size < arena_len + len + 1)
+      new_size *= 2;
+    if (!(a = realloc(word_arena, new_size * sizeof(wchar_t))))
+      goto nomem;
+    word_arena = a;
+    arena_cap = new_size;
+  }
+
+  wmemcpy(word_arena + arena_len, word, len);
+  word_arena[arena_len + len] = '\0';
+  word_offset[num_words] = arena_len;
+  word_len[num_words] = len;
+  arena_len += len + 1;
+  num_words++;
+  return 1;
+
+nomem:
+  fprintf(stderr, "add_word() - out of memory after %d words\n", num_words);
+  return 0;
+}
+
+
+static void free_word_list(void)
+{
+  free(word_offset);
+  free(word_len);
+  free(words_by_len);
+  free(word_arena);
+  word_offset = word_len = words_by_len = NULL;
+  word_arena = NULL;
+  num_words = words_cap = 0;
+  arena_len = arena_cap = 0;
+}
+
+
+/* Returns the next word of length "len" from its shuffle bag,  */
+/* reshuffling once the whole bag has been handed out.  The new */
+/* order never starts with the word that was returned last.     */
+static int next_from_bag(int len)
+{
+  int* bag = words_by_len + len_start[len];
+  int size = len_start[len + 1] - len_start[len];
+  int i, j, tmp;
+
+  if (bag_pos[len] >= size)
+  {
+    for (i = size - 1; i > 0; i--)
+    {
+      j = rand() % (i + 1);
+      tmp = bag[i];
+      bag[i] = bag[j];
+      bag[j] = tmp;
+    }
+    if (size > 1 && bag[0] == last_word)
+    {
+      tmp = bag[0];
+      bag[0] = bag[size - 1];
+      bag[size - 1] = tmp;
+    }
+    bag_pos[len] = 0;
+  }
+
+  return bag[bag_pos[len]++];
+}
+
+
 
 void ResetCharList(void)
 {
   char_list[0] = '\0';
+  uni_index_clear(&char_list_index);
 }
 
 
@@ -1399,19 +1563,14 @@ void GenCharListFromString(const char* UTF8_str)
 /* Checks to see if the argument is already in the list and adds    */
 /* it if necessary.  Returns 1 if char added, 0 if already in list, */
 /* -1 if list already up to maximum size:                           */
-/* FIXME performance would be better with hashtable                 */
 static int add_char(wchar_t uc)
 {
-  int i = 0;
-  while ((char_list[i] != uc)
-      && (char_list[i] != '\0')
-      && (i < MAX_UNICODES - 1))          //Because 1 need for null terminator
-  {
-    i++;
-  }
+  /* The index holds exactly the entries of char_list[], so its */
+  /* count is also the current length of the list:              */
+  int i = char_list_index.count;
 
   /* unicode already in list: */
-  if (char_list[i] == uc)
+  if (uni_index_find(&char_list_index, uc) >= 0)
   {
     DEBUGCODE{ fprintf(stderr,
                        "Unicode value: %d\tcharacter %lc already in list\n",
@@ -1419,20 +1578,71 @@ static int add_char(wchar_t uc)
     return 0;
   }
 
-  if (char_list[i] == '\0')
+  if (i >= MAX_UNICODES - 1)            //Because 1 need for null terminator
   {
-    DEBUGCODE{ fprintf(stderr, "Adding unicode value: %d\tcharacter %lc\n", uc, uc);}
-    char_list[i] = uc;
-    char_list[i + 1] = '\0';
-    return 1;
+    LOG ("Unable to add unicode - list at max capacity");
+    return -1;
   }
 
-  if (i == MAX_UNICODES - 1)            //Because 1 need for null terminator
-  {
-    LOG ("Unable to add unicode - list at max capacity");
+  DEBUGCODE{ fprintf(stderr, "Adding unicode value: %d\tcharacter %lc\n", uc, uc);}
+  char_list[i] = uc;
+  char_list[i + 1] = '\0';
+  uni_index_add(&char_list_index, uc, i);
+  return 1;
+}
+
+
+
+/* Hash of a Unicode value into the uni_index table (Fibonacci hashing): */
+static unsigned int uni_index_hash(wchar_t uc)
+{
+  return ((Uint32)uc * 2654435761u) >> (32 - UNI_INDEX_BITS);
+}
+
+
+static void uni_index_clear(uni_index* ix)
+{
+  memset(ix->val, 0, sizeof(ix->val));
+  ix->count = 0;
+}
+
+
+/* Records that 'uc' lives at position 'val'. If 'uc' is already in the */
+/* index, the existing entry is kept (so the first occurrence wins, as  */
+/* with the old linear scans). Returns 1 if added, 0 if already there,  */
+/* -1 if the index is full:                                             */
+static int uni_index_add(uni_index* ix, wchar_t uc, int val)
+{
+  unsigned int h = uni_index_hash(uc);
+
+  if (ix->count >= MAX_UNICODES)
     return -1;
+
+  while (ix->val[h])
+  {
+    if (ix->key[h] == uc)
+      return 0;
+    h = (h + 1) & (UNI_INDEX_SIZE - 1);
+  }
+
+  ix->key[h] = uc;
+  ix->val[h] = val + 1;
+  ix->count++;
+  return 1;
+}
+
+
+/* Returns the position recorded for 'uc', or -1 if not in index: */
+static int uni_index_find(const uni_index* ix, wchar_t uc)
+{
+  unsigned int h = uni_index_hash(uc);
+
+  while (ix->val[h])
+  {
+    if (ix->key[h] == uc)
+      return ix->val[h] - 1;
+    h = (h + 1) & (UNI_INDEX_SIZE - 1);
   }
-  // We never want to get here...
   return -1;
 }
 
@@ -1446,4 +1656,5 @@ static void clear_keyboard(void)
     keyboard_list[i].unicode_value = 0;
     keyboard_list[i].finger = -1;
   }
+  uni_index_clear(&key_index);
 }
@@ -0,0 +1,227 @@
+/*
+   announcer.c:
+
+   Description: speech thread shared by the cascade and comet games.
+   The game loop is the only producer and the announcer thread the
+   only consumer of a small ring of announcements, so neither side
+   takes a lock; the thread sleeps on a semaphore while the ring is
+   empty.  Everything the thread speaks is copied into the ring, so
+   it never touches game state.
+
+   Copyright 2010.
+   Project email: <tux4kids-tuxtype-dev@lists.alioth.debian.org>
+   Project website: http://tux4kids.alioth.debian.org
+
+   announcer.c is part of Tux Typing, a.k.a "tuxtype".
+
+Tux Typing is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+(at your option) any later version.
+
+Tux Typing is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#include "globals.h"
+#include "funcs.h"
+#include "compiler.h"
+#include "announcer.h"
+
+/* Must be a power of two: */
+#define ANNOUNCE_QUEUE_LEN 16
+#define ANNOUNCE_QUEUE_MASK (ANNOUNCE_QUEUE_LEN - 1)
+
+enum {
+  ANNOUNCE_TEXT,     /* say "text" at "pitch"           */
+  ANNOUNCE_COUNT,    /* say printf-style "format", value */
+  ANNOUNCE_QUIT      /* end the announcer thread         */
+};
+
+typedef struct announcement {
+  int type;
+  int pitch;
+  int value;
+  unsigned int generation;
+  const char* format;
+  wchar_t text[ANNOUNCE_TEXT_LEN];
+} announcement;
+
+static announcement queue[ANNOUNCE_QUEUE_LEN];
+static volatile unsigned int queue_head = 0;   /* only the game loop writes */
+static volatile unsigned int queue_tail = 0;   /* only the thread writes    */
+static volatile unsigned int generation = 0;   /* bumped to drop queued items */
+static volatile int speaking = 0;
+static SDL_sem* queue_sem = NULL;
+
+static announcement* reserve_slot(int type);
+static void commit_slot(void);
+static int announcer_thread(void* unused);
+
+
+
+/* Starts the announcer thread if it is not already running.   */
+/* It stays blocked on its semaphore while nothing is posted,  */
+/* so it can be left running across pauses and levels.        */
+int StartAnnouncer(void)
+{
+  if (tts_announcer_thread)
+    return 1;
+
+  queue_sem = SDL_CreateSemaphore(0);
+  if (!queue_sem)
+  {
+    fprintf(stderr, "StartAnnouncer() - SDL_CreateSemaphore() failed: %s\n", SDL_GetError());
+    return 0;
+  }
+
+  queue_head = queue_tail = 0;
+  speaking = 0;
+  tts_announcer_thread = SDL_CreateThread(announcer_thread, NULL);
+  if (!tts_announcer_thread)
+  {
+    fprintf(stderr, "StartAnnouncer() - SDL_CreateThread() failed: %s\n", SDL_GetError());
+    SDL_DestroySemaphore(queue_sem);
+    queue_sem = NULL;
+    return 0;
+  }
+  return 1;
+}
+
+
+/* Drops anything still queued and waits for the thread to end: */
+void StopAnnouncer(void)
+{
+  if (!tts_announcer_thread)
+    return;
+
+  ClearAnnouncements();
+  /* The thread always drains the ring, so a slot frees up soon: */
+  while (!reserve_slot(ANNOUNCE_QUIT))
+    SDL_Delay(10);
+  commit_slot();
+
+  SDL_WaitThread(tts_announcer_thread, NULL);
+  tts_announcer_thread = NULL;
+  SDL_DestroySemaphore(queue_sem);
+  queue_sem = NULL;
+}
+
+
+/* Everything posted before this call is skipped rather than spoken. */
+/* The announcement currently being spoken is not cut short.         */
+void ClearAnnouncements(void)
+{
+  generation++;
+}
+
+
+/* Queues "text" to be spoken; returns 0 if the ring is full. */
+int AnnounceText(const wchar_t* text, int pitch_and_rate)
+{
+  announcement* a;
+
+  if (!text || !(a = reserve_slot(ANNOUNCE_TEXT)))
+    return 0;
+
+  wcsncpy(a->text, text, ANNOUNCE_TEXT_LEN - 1);
+  a->text[ANNOUNCE_TEXT_LEN - 1] = L'\0';
+  a->pitch = pitch_and_rate;
+  commit_slot();
+  return 1;
+}
+
+
+/* Queues a message such as "%d lives remaining!".  "format" must */
+/* outlive the announcement, so pass a string literal.            */
+int AnnounceCount(const char* format, int value)
+{
+  announcement* a;
+
+  if (!format || !(a = reserve_slot(ANNOUNCE_COUNT)))
+    return 0;
+
+  a->format = format;
+  a->value = value;
+  commit_slot();
+  return 1;
+}
+
+
+/* True when nothing is queued or being spoken, i.e. when the */
+/* game loop should post the next round of announcements.     */
+int AnnouncerIdle(void)
+{
+  return tts_announcer_thread && queue_head == queue_tail && !speaking;
+}
+
+
+
+/****************** Local functions ************************/
+
+/* Producer side: returns the next free slot, or NULL if full. */
+static announcement* reserve_slot(int type)
+{
+  announcement* a;
+
+  if (!queue_sem || queue_head - queue_tail >= ANNOUNCE_QUEUE_LEN)
+    return NULL;
+
+  a = &queue[queue_head & ANNOUNCE_QUEUE_MASK];
+  a->type = type;
+  a->generation = generation;
+  return a;
+}
+
+
+/* Publishes the slot from reserve_slot() and wakes the thread: */
+static void commit_slot(void)
+{
+  MEMORY_BARRIER();
+  queue_head++;
+  SDL_SemPost(queue_sem);
+}
+
+
+static int announcer_thread(void* unused)
+{
+  announcement a;
+
+  while (1)
+  {
+    SDL_SemWait(queue_sem);
+    MEMORY_BARRIER();
+
+    /* Copy the slot out before handing it back to the producer. */
+    /* "speaking" goes up first so AnnouncerIdle() never sees an */
+    /* empty ring while an item is still pending.                */
+    a = queue[queue_tail & ANNOUNCE_QUEUE_MASK];
+    speaking = 1;
+    MEMORY_BARRIER();
+    queue_tail++;
+
+    if (a.type == ANNOUNCE_QUIT)
+      break;
+
+    if (a.generation == generation)
+    {
+      if (a.type == ANNOUNCE_TEXT)
+        T4K_Tts_say(a.pitch, a.pitch, INTERRUPT, "%S", a.text);
+      else
+        T4K_Tts_say(DEFAULT_VALUE, DEFAULT_VALUE, INTERRUPT, a.format, a.value);
+      T4K_Tts_wait();
+    }
+
+    speaking = 0;
+  }
+
+  speaking = 0;
+  return 0;
+}
@@ -0,0 +1,42 @@
+/*
+   announcer.h:
+
+   Description: header file for the queue of spoken announcements
+   used by the games' TTS thread.
+
+   Copyright 2010.
+   Project email: <tux4kids-tuxtype-dev@lists.alioth.debian.org>
+   Project website: http://tux4kids.alioth.debian.org
+
+   announcer.h is part of Tux Typing, a.k.a "tuxtype".
+
+Tux Typing is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+(at your option) any later version.
+
+Tux Typing is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ANNOUNCER_H
+#define ANNOUNCER_H
+
+#include <wchar.h>
+
+/* Longest utterance the game loops can post, including the null: */
+#define ANNOUNCE_TEXT_LEN 512
+
+int  StartAnnouncer(void);
+void StopAnnouncer(void);
+void ClearAnnouncements(void);
+int  AnnounceText(const wchar_t* text, int pitch_and_rate);
+int  AnnounceCount(const char* format, int value);
+int  AnnouncerIdle(void);
+
+#endif
@@ -1,8 +1,8 @@
 /*
    braille.c:
 
-   Description: Functions for loding braille map and key's
-				order correcter 
+   Description: Functions for loding braille map and looking
+				up key chords 
    
    Copyright 2013.
    Author: Nalin.x.Linux < Nalin.x.Linux@gmail.com > 
@@ -26,34 +26,105 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "globals.h"
+#include "braille.h"
 
-/* Arrange the given disordered keycombination 
- * to assigned combination (fdsjkl) */
-void arrange_in_order(wchar_t *disorder)
+/* Size of braille_key_value_map[] (see globals.c): */
+#define BRAILLE_MAP_SIZE 100
+/* Open-addressed char -> map entry table, a power of two comfortably */
+/* bigger than the 3 values of each map entry:                        */
+#define BRAILLE_REV_SIZE 1024
+
+/* First map entry for each chord, or NULL - filled in by the loader: */
+static struct braille_dict* chord_table[BRAILLE_NUM_CHORDS];
+/* Chord of each map entry: */
+static int entry_chord[BRAILLE_MAP_SIZE];
+/* Next entry with the same chord, in file order, or -1.  Some maps */
+/* give one chord to two characters (e.g. Hindi "dj" for both i and */
+/* ii), and every one of them has to stay typable:                  */
+static int next_same_chord[BRAILLE_MAP_SIZE];
+
+static struct {
+  wchar_t c;     /* 0 if slot is empty */
+  int entry;
+} rev_table[BRAILLE_REV_SIZE];
+
+static void build_lookup_tables(int num_entries);
+static void rev_table_add(wchar_t c, int entry);
+
+
+/* Returns the bit for braille key 'key' (f d s j k l = dots 1-6), */
+/* or 0 if it isn't one of those keys:                             */
+int braille_key_dot(wchar_t key)
 {
-	int iter=0,i,j,len;
-	wchar_t *order = malloc(sizeof(char)*100);
-	wchar_t *temp = malloc(sizeof(char)*100);
-	
-	wcscpy(order,L"fdsjkl");	
-	wcscpy(temp,disorder);
+	switch (key)
+	{
+		case L'f': return 1 << 0;
+		case L'd': return 1 << 1;
+		case L's': return 1 << 2;
+		case L'j': return 1 << 3;
+		case L'k': return 1 << 4;
+		case L'l': return 1 << 5;
+		default:   return 0;
+	}
+}
+
+
+/* Chord made by the given keys, in any order - others are ignored: */
+int braille_chord_from_keys(const wchar_t* keys)
+{
+	int chord = 0;
+
+	if (!keys)
+		return 0;
+	for (; *keys; keys++)
+		chord |= braille_key_dot(*keys);
+	return chord;
+}
+
+
+/* First map entry typed by 'chord', or NULL if the chord means nothing. */
+/* Use braille_chord_next() for any others with the same chord:          */
+struct braille_dict* braille_chord_lookup(int chord)
+{
+	if (chord <= 0 || chord >= BRAILLE_NUM_CHORDS)
+		return NULL;
+	return chord_table[chord];
+}
+
+
+/* Next map entry typed by the same chord as 'entry', or NULL: */
+struct braille_dict* braille_chord_next(struct braille_dict* entry)
+{
+	int i;
+
+	if (!entry)
+		return NULL;
+	i = next_same_chord[entry - braille_key_value_map];
+	return (i < 0) ? NULL : &braille_key_value_map[i];
+}
+
+
+/* Map entry with 'c' as its beginning, middle or end value, or NULL. */
+/* If 'chord' is not NULL it gets the entry's chord:                  */
+struct braille_dict* braille_char_lookup(wchar_t c, int* chord)
+{
+	unsigned int h;
+
+	if (c == 0)
+		return NULL;
 
-	len = wcslen(disorder);
-	disorder[iter] = L'\0';
-		
-	for(i=0;i<6;i++)
+	for (h = (unsigned int)c * 2654435761u % BRAILLE_REV_SIZE;
+	     rev_table[h].c != 0;
+	     h = (h + 1) % BRAILLE_REV_SIZE)
 	{
-		
-		for(j=0;j<len;j++)
+		if (rev_table[h].c == c)
 		{
-			if (order[i] == temp[j])
-			{				
-				disorder[iter] = order[i];
-				iter++;
-			}
+			if (chord)
+				*chord = entry_chord[rev_table[h].entry];
+			return &braille_key_value_map[rev_table[h].entry];
 		}
 	}
-	disorder[iter] = L'\0';
+	return NULL;
 }
 
 
@@ -65,8 +136,8 @@ void arrange_in_order(wchar_t *disorder)
  * For some specific language's which have same braille code for
  * alphabets and signs at begining, middle and end position.
  * 
- * The keyvombination should be writen in the order fdsjkl.
- * means first f second d so on. */
+ * The keycombination can be written in any order of f d s j k l.
+ * Several lines may share a keycombination - see braille_chord_next(). */
 int braille_language_loader(char* language)
 {
 	int iter = 0;
@@ -82,13 +153,79 @@ int braille_language_loader(char* language)
 		return 0;
 	}
 			
-	while(!feof(fp))
+	while(!feof(fp) && iter < BRAILLE_MAP_SIZE)
 	{
-		fscanf(fp,"%S %S %S %S\n",braille_key_value_map[iter].key,
+		if (fscanf(fp,"%99S %99S %99S %99S\n",braille_key_value_map[iter].key,
 			braille_key_value_map[iter].value_begin,
 			braille_key_value_map[iter].value_middle,
-			braille_key_value_map[iter].value_end);
+			braille_key_value_map[iter].value_end) != 4)
+			break;
 		iter++;
 	}
+	fclose(fp);
+
+	build_lookup_tables(iter);
 	return 1;
 }
+
+
+static void build_lookup_tables(int num_entries)
+{
+	int i;
+	int last[BRAILLE_NUM_CHORDS];   /* last entry chained for each chord */
+
+	memset(chord_table, 0, sizeof(chord_table));
+	memset(rev_table, 0, sizeof(rev_table));
+
+	/* Clear out anything left over from a longer map loaded before: */
+	for (i = num_entries; i < BRAILLE_MAP_SIZE; i++)
+	{
+		braille_key_value_map[i].key[0] = L'\0';
+		braille_key_value_map[i].value_begin[0] = L'\0';
+		braille_key_value_map[i].value_middle[0] = L'\0';
+		braille_key_value_map[i].value_end[0] = L'\0';
+		entry_chord[i] = 0;
+		next_same_chord[i] = -1;
+	}
+
+	for (i = 0; i < num_entries; i++)
+	{
+		struct braille_dict* d = &braille_key_value_map[i];
+		int chord = braille_chord_from_keys(d->key);
+
+		entry_chord[i] = chord;
+		next_same_chord[i] = -1;
+		if (chord)
+		{
+			if (!chord_table[chord])
+				chord_table[chord] = d;
+			else
+				next_same_chord[last[chord]] = i;
+			last[chord] = i;
+		}
+
+		rev_table_add(d->value_begin[0], i);
+		rev_table_add(d->value_middle[0], i);
+		rev_table_add(d->value_end[0], i);
+	}
+}
+
+
+/* Adds 'c' unless already there (so the first entry with it wins): */
+static void rev_table_add(wchar_t c, int entry)
+{
+	unsigned int h;
+
+	if (c == 0)
+		return;
+
+	for (h = (unsigned int)c * 2654435761u % BRAILLE_REV_SIZE;
+	     rev_table[h].c != 0;
+	     h = (h + 1) % BRAILLE_REV_SIZE)
+	{
+		if (rev_table[h].c == c)
+			return;
+	}
+	rev_table[h].c = c;
+	rev_table[h].entry = entry;
+}
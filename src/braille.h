@@ -1,3 +1,44 @@
-void arrange_in_order(wchar_t *disorder);
+/*
+   braille.h:
+
+   Description: header file for loading the braille key map and
+   looking up key chords.
+
+   Copyright 2013.
+   Author: Nalin.x.Linux < Nalin.x.Linux@gmail.com > 
+   Project email: <tux4kids-tuxtype-dev@lists.alioth.debian.org>
+   Project website: http://tux4kids.alioth.debian.org
+
+   braille.h is part of Tux Typing, a.k.a "tuxtype".
+
+Tux Typing is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+(at your option) any later version.
+
+Tux Typing is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BRAILLE_H
+#define BRAILLE_H
+
+/* (needs struct braille_dict from globals.h, included first) */
+
+/* A chord is the set of braille keys held down together, as a 6-bit  */
+/* mask: f, d, s, j, k, l (dots 1-6) are bits 0-5. 0 means no keys.    */
+#define BRAILLE_NUM_CHORDS 64
+
 int braille_language_loader(char* language);
+int braille_key_dot(wchar_t key);
+int braille_chord_from_keys(const wchar_t* keys);
+struct braille_dict* braille_chord_lookup(int chord);
+struct braille_dict* braille_chord_next(struct braille_dict* entry);
+struct braille_dict* braille_char_lookup(wchar_t c, int* chord);
 
+#endif
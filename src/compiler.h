@@ -94,6 +94,20 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define FUNCTION
 #endif
 
+// Per-thread storage for file-scope statics (e.g. cached converters):
+#ifdef __GNUC__
+#define THREAD_LOCAL __thread
+#else
+#define THREAD_LOCAL
+#endif
+
+// Full memory barrier, for lock-free queues shared with helper threads:
+#if __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 1)
+#define MEMORY_BARRIER() __sync_synchronize()
+#else
+#define MEMORY_BARRIER() do { } while (0)
+#endif
+
 #if !defined(restrict) && __STDC_VERSION__ < 199901
 #if __GNUC__ > 2 || __GNUC_MINOR__ >= 92
 #define restrict __restrict__
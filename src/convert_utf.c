@@ -2,7 +2,9 @@
    convert_utf.c:
 
    Description: simple wrapper functions to convert
-   wchar_t and utf8 strings using GNU iconv().
+   wchar_t and utf8 strings.  Where wchar_t is UTF-32 we
+   do the conversion ourselves; on Windows (UTF-16 wchar_t)
+   we still use GNU iconv().
    
    Copyright 2009, 2010.
    Author: David Bruce.
@@ -29,97 +31,417 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "convert_utf.h"
 #include "globals.h"
+#include "compiler.h"
 
+#ifdef WIN32
 #include <iconv.h>
+#include <errno.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
-#define UTF_BUF_LENGTH 1024
 
-/* GNU iconv()-based implementation:   */
+#ifdef WIN32
 
-int ConvertFromUTF8(wchar_t* wide_word, const char* UTF8_word, int max_length)
+/* GNU iconv()-based implementation, used where wchar_t is UTF-16:   */
+
+/* iconv_open() is far too slow to call for every string, so we keep  */
+/* one descriptor for each direction. iconv_t objects must not be     */
+/* shared between threads, hence one pair per thread:                 */
+static THREAD_LOCAL iconv_t from_utf8_descr = (iconv_t)-1;
+static THREAD_LOCAL iconv_t to_utf8_descr = (iconv_t)-1;
+
+static int convert_from_utf8(wchar_t* wide_word, const char* UTF8_word, int max_length, int* bad_input)
 {
-  wchar_t temp_wchar[UTF_BUF_LENGTH];
-  wchar_t* wchar_start = temp_wchar;
+  char* out_start = (char*)wide_word;
+  size_t in_length;
+  size_t out_length;
+  int ret;
+
+  if (!wide_word || !UTF8_word || max_length < 1)
+    return 0;
 
-  iconv_t conv_descr;
-  size_t bytes_converted;
-  size_t in_length = (size_t)UTF_BUF_LENGTH;
-  size_t out_length = (size_t)UTF_BUF_LENGTH;
+  DEBUGCODE {fprintf(stderr, "ConvertFromUTF8(): UTF8_word = %s\n", UTF8_word);}
 
-  if(max_length > UTF_BUF_LENGTH)
+  /* NOTE although we *should* be just able to pass "wchar_t" as the out_type, */
+  /* iconv_open() segfaults on Windows if this is done - grrr....             */
+  if (from_utf8_descr == (iconv_t)-1)
+    from_utf8_descr = iconv_open("UTF-16LE", "UTF-8");
+  if (from_utf8_descr == (iconv_t)-1)
   {
-    fprintf(stderr, "ConvertFromUTF8() - error - requested string length %d exceeds buffer length %d\n",
-            max_length, UTF_BUF_LENGTH);
+    fprintf(stderr, "ConvertFromUTF8() - iconv_open() failed\n");
+    wide_word[0] = '\0';
+    *bad_input = 1;
     return 0;
   }
 
-  DEBUGCODE {fprintf(stderr, "ConvertFromUTF8(): UTF8_word = %s\n", UTF8_word);}
+  /* Convert only the real string, leaving room for the terminator: */
+  in_length = strlen(UTF8_word);
+  out_length = (max_length - 1) * sizeof(wchar_t);
 
-  /* NOTE although we *should* be just able to pass "wchar_t" as the out_type, */
+  /* Reset shift state left over from previous call: */
+  iconv(from_utf8_descr, NULL, NULL, NULL, NULL);
+  ret = iconv(from_utf8_descr,
+              (char**) &UTF8_word, &in_length,
+              &out_start, &out_length);
+  *(wchar_t*)out_start = '\0';
+
+  DEBUGCODE {fprintf(stderr, "ConvertFromUTF8(): wide_word = %S\n", wide_word);}
+
+  /* E2BIG just means we truncated to fit the buffer; otherwise */
+  /* keep the valid part converted before the bad sequence:     */
+  if (ret == -1 && errno != E2BIG)
+  {
+    fprintf(stderr, "ConvertFromUTF8() - invalid UTF-8 sequence\n");
+    *bad_input = 1;
+  }
+
+  return wcslen(wide_word);
+}
+
+
+int ConvertToUTF8(const wchar_t* wide_word, char* UTF8_word, int max_length)
+{
+  char* out_start = UTF8_word;
+  size_t in_length;
+  size_t out_length;
+  int ret;
+
+  if (!wide_word || !UTF8_word || max_length < 1)
+    return 0;
+
+  DEBUGCODE {fprintf(stderr, "ConvertToUTF8(): wide_word = %S\n", wide_word);}
+
+  /* NOTE although we *should* be just able to pass "wchar_t" as the in_type, */
   /* iconv_open() segfaults on Windows if this is done - grrr....             */
-#ifdef WIN32
-  conv_descr = iconv_open("UTF-16LE", "UTF-8");
+  if (to_utf8_descr == (iconv_t)-1)
+    to_utf8_descr = iconv_open("UTF-8", "UTF-16LE");
+  if (to_utf8_descr == (iconv_t)-1)
+  {
+    fprintf(stderr, "ConvertToUTF8() - iconv_open() failed\n");
+    UTF8_word[0] = '\0';
+    return 0;
+  }
+
+  in_length = wcslen(wide_word) * sizeof(wchar_t);
+  out_length = max_length - 1;
+
+  iconv(to_utf8_descr, NULL, NULL, NULL, NULL);
+  ret = iconv(to_utf8_descr,
+              (char**) &wide_word, &in_length,
+              &out_start, &out_length);
+  *out_start = '\0';
+
+  DEBUGCODE {fprintf(stderr, "ConvertToUTF8(): UTF8_word = %s\n", UTF8_word);}
+
+  if (ret == -1 && errno != E2BIG)
+    fprintf(stderr, "ConvertToUTF8() - invalid wide character\n");
+
+  return strlen(UTF8_word);
+}
+
+
 #else
-  conv_descr = iconv_open("wchar_t", "UTF-8");
-#endif
 
-  bytes_converted = iconv(conv_descr,
-                          (char**) &UTF8_word, &in_length,
-                          (char**) &wchar_start, &out_length);
-  iconv_close(conv_descr);
-  wcsncpy(wide_word, temp_wchar, max_length);
+/* Direct UTF-8 <-> UTF-32 implementation, used where wchar_t is UTF-32. */
+/* Nearly all of our strings are plain ASCII, so we first copy as many   */
+/* ASCII bytes as possible in blocks before falling back to decoding     */
+/* one character at a time.                                              */
 
-  DEBUGCODE {fprintf(stderr, "ConvertToUTF8(): wide_word = %S\n", wide_word);}
+/* Copies the leading run of ASCII chars from 'in' to 'out', stopping */
+/* at the first non-ASCII byte, the terminating null, or after 'max'  */
+/* chars.  Returns the number of chars copied:                        */
+static int copy_ascii_run(wchar_t* out, const unsigned char* in, int max)
+{
+  int i = 0;
 
-  return wcslen(wide_word);
+#ifdef __SSE2__
+  /* 16 bytes at a time, as long as none are null or >= 0x80.  We may  */
+  /* read a little past the terminating null, so never let a load     */
+  /* cross into the next (possibly unmapped) 4K page:                 */
+  const __m128i zero = _mm_setzero_si128();
+  while (i + 16 <= max
+      && ((size_t)(in + i) & 4095) <= 4096 - 16)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+    __m128i lo, hi;
+
+    if (_mm_movemask_epi8(v) | _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)))
+      break;
+
+    lo = _mm_unpacklo_epi8(v, zero);
+    hi = _mm_unpackhi_epi8(v, zero);
+    _mm_storeu_si128((__m128i*)(out + i),      _mm_unpacklo_epi16(lo, zero));
+    _mm_storeu_si128((__m128i*)(out + i + 4),  _mm_unpackhi_epi16(lo, zero));
+    _mm_storeu_si128((__m128i*)(out + i + 8),  _mm_unpacklo_epi16(hi, zero));
+    _mm_storeu_si128((__m128i*)(out + i + 12), _mm_unpackhi_epi16(hi, zero));
+    i += 16;
+  }
+#endif
+
+  while (i < max && in[i] && in[i] < 0x80)
+  {
+    out[i] = in[i];
+    i++;
+  }
+  return i;
 }
 
 
-/* Now this uses GNU iconv and works correctly!   */
-/* This probably could be simplified - not certain */
-/* we have to copy into and out of the buffers     */
+/* NOTE "max_length" is the size of the output buffer including the  */
+/* terminating null.  Longer strings are truncated at a character     */
+/* boundary.  If the input is not valid UTF-8, wide_word holds the   */
+/* valid part of the string, its length is returned and '*bad_input' */
+/* is set.                                                            */
+static int convert_from_utf8(wchar_t* wide_word, const char* UTF8_word, int max_length, int* bad_input)
+{
+  const unsigned char* in = (const unsigned char*)UTF8_word;
+  int max_out;
+  int n = 0;
+
+  if (!wide_word || !UTF8_word || max_length < 1)
+    return 0;
+
+  DEBUGCODE {fprintf(stderr, "ConvertFromUTF8(): UTF8_word = %s\n", UTF8_word);}
+
+  max_out = max_length - 1;
+
+  while (n < max_out)
+  {
+    wchar_t c;
+    int extra, i;
+    int ascii = copy_ascii_run(wide_word + n, in, max_out - n);
+
+    n += ascii;
+    in += ascii;
+
+    if (*in == '\0' || n == max_out)
+      break;
+
+    /* Multibyte sequence - work out its length from the lead byte: */
+    if (*in >= 0xC2 && *in <= 0xDF)
+    {
+      c = *in & 0x1F;
+      extra = 1;
+    }
+    else if (*in >= 0xE0 && *in <= 0xEF)
+    {
+      c = *in & 0x0F;
+      extra = 2;
+    }
+    else if (*in >= 0xF0 && *in <= 0xF4)
+    {
+      c = *in & 0x07;
+      extra = 3;
+    }
+    else
+      goto invalid;
+
+    for (i = 1; i <= extra; i++)
+    {
+      if ((in[i] & 0xC0) != 0x80)
+        goto invalid;
+      c = (c << 6) | (in[i] & 0x3F);
+    }
+
+    /* Reject overlong forms, surrogates, and values past Unicode range: */
+    if ((extra == 2 && c < 0x800)
+     || (extra == 3 && c < 0x10000)
+     || (c >= 0xD800 && c <= 0xDFFF)
+     || c > 0x10FFFF)
+      goto invalid;
+
+    wide_word[n++] = c;
+    in += extra + 1;
+  }
+
+  wide_word[n] = '\0';
+
+  DEBUGCODE {fprintf(stderr, "ConvertFromUTF8(): wide_word = %S\n", wide_word);}
+
+  return n;
+
+invalid:
+  wide_word[n] = '\0';
+  fprintf(stderr, "ConvertFromUTF8() - invalid UTF-8 sequence in '%s'\n", UTF8_word);
+  *bad_input = 1;
+  return n;
+}
+
 
 /******************To be used for savekeyboard*************/
 /***Converts wchar_t string to char string*****************/
+/* As above, "max_length" is the size of the output buffer. */
 int ConvertToUTF8(const wchar_t* wide_word, char* UTF8_word, int max_length)
 {
-  char temp_UTF8[UTF_BUF_LENGTH];
-  /* NOTE we need this because iconv_open() needs a char**.  We can't   */
-  /* just pass "&temp_UTF8" because "temp_UTF8" is really a shorthand   */
-  /* for "&temp_UTF8[0]", not its own memory location, so it doesn't    */
-  /* have its own address. We ought to be able to do this directly into */
-  /* into the argument UTF8_word string, but so far have had errors.    */
-  char* UTF8_Start = temp_UTF8;
-
-  iconv_t conv_descr;
-  size_t bytes_converted;
-  size_t in_length = (size_t)UTF_BUF_LENGTH;
-  size_t out_length = (size_t)UTF_BUF_LENGTH;
+  unsigned char* out = (unsigned char*)UTF8_word;
+  unsigned char* end;
+
+  if (!wide_word || !UTF8_word || max_length < 1)
+    return 0;
 
   DEBUGCODE {fprintf(stderr, "ConvertToUTF8(): wide_word = %S\n", wide_word);}
 
-  if(max_length > UTF_BUF_LENGTH)
+  /* leave room for the terminating null: */
+  end = out + max_length - 1;
+
+  for (; *wide_word != '\0'; wide_word++)
   {
-    fprintf(stderr, "ConvertToUTF8() - error - requested string length %d exceeds buffer length %d\n",
-            max_length, UTF_BUF_LENGTH);
-    return 0;
+    Uint32 c = (Uint32)*wide_word;
+
+    if (likely(c < 0x80))
+    {
+      if (out + 1 > end)
+        break;
+      *out++ = c;
+    }
+    else if (c < 0x800)
+    {
+      if (out + 2 > end)
+        break;
+      *out++ = 0xC0 | (c >> 6);
+      *out++ = 0x80 | (c & 0x3F);
+    }
+    else if (c < 0x10000)
+    {
+      if (c >= 0xD800 && c <= 0xDFFF)
+      {
+        *out = '\0';
+        fprintf(stderr, "ConvertToUTF8() - invalid Unicode value %d\n", c);
+        return (char*)out - UTF8_word;
+      }
+      if (out + 3 > end)
+        break;
+      *out++ = 0xE0 | (c >> 12);
+      *out++ = 0x80 | ((c >> 6) & 0x3F);
+      *out++ = 0x80 | (c & 0x3F);
+    }
+    else if (c <= 0x10FFFF)
+    {
+      if (out + 4 > end)
+        break;
+      *out++ = 0xF0 | (c >> 18);
+      *out++ = 0x80 | ((c >> 12) & 0x3F);
+      *out++ = 0x80 | ((c >> 6) & 0x3F);
+      *out++ = 0x80 | (c & 0x3F);
+    }
+    else
+    {
+      *out = '\0';
+      fprintf(stderr, "ConvertToUTF8() - invalid Unicode value %d\n", c);
+      return (char*)out - UTF8_word;
+    }
   }
+  *out = '\0';
+
+  DEBUGCODE {fprintf(stderr, "ConvertToUTF8(): UTF8_word = %s\n", UTF8_word);}
+
+  return (char*)out - UTF8_word;
+}
 
-  /* NOTE although we *should* be just able to pass "wchar_t" as the in_type, */
-  /* iconv_open() segfaults on Windows if this is done - grrr....             */
-#ifdef WIN32
-  conv_descr = iconv_open("UTF-8", "UTF-16LE");
-#else
-  conv_descr = iconv_open("UTF-8", "wchar_t");
 #endif
 
-  bytes_converted = iconv(conv_descr,
-                          (char**) &wide_word, &in_length,
-                          (char**) &UTF8_Start, &out_length);
-  iconv_close(conv_descr);
-  strncpy(UTF8_word, temp_UTF8, max_length);
 
-  DEBUGCODE {fprintf(stderr, "ConvertToUTF8(): UTF8_word = %s\n", UTF8_word);}
+int ConvertFromUTF8(wchar_t* wide_word, const char* UTF8_word, int max_length)
+{
+  int bad_input = 0;
+  return convert_from_utf8(wide_word, UTF8_word, max_length, &bad_input);
+}
 
-  return strlen(UTF8_word);
+
+/* For callers that would rather reject bad input than keep part of it: */
+int ConvertFromUTF8Strict(wchar_t* wide_word, const char* UTF8_word, int max_length)
+{
+  int bad_input = 0;
+  int n = convert_from_utf8(wide_word, UTF8_word, max_length, &bad_input);
+
+  if (bad_input)
+  {
+    wide_word[0] = '\0';
+    return -1;
+  }
+  return n;
+}
+
+
+
+/* The wide string builder does not depend on the conversion backend.  Every  */
+/* append keeps one slot in reserve for the terminating null.                 */
+
+void wsb_init(wstr_builder* sb, wchar_t* storage, size_t cap)
+{
+  if (!sb)
+    return;
+  sb->buf = storage;
+  sb->cap = storage ? cap : 0;
+  wsb_reset(sb);
+}
+
+
+void wsb_reset(wstr_builder* sb)
+{
+  if (!sb)
+    return;
+  sb->len = 0;
+  sb->truncated = 0;
+  if (sb->cap)
+    sb->buf[0] = L'\0';
+}
+
+
+void wsb_add_n(wstr_builder* sb, const wchar_t* s, size_t n)
+{
+  size_t room;
+
+  if (!sb || !s || !sb->cap)
+    return;
+
+  room = sb->cap - 1 - sb->len;
+  if (n > room)
+  {
+    n = room;
+    sb->truncated = 1;
+  }
+  wmemcpy(sb->buf + sb->len, s, n);
+  sb->len += n;
+  sb->buf[sb->len] = L'\0';
+}
+
+
+void wsb_add(wstr_builder* sb, const wchar_t* s)
+{
+  if (s)
+    wsb_add_n(sb, s, wcslen(s));
+}
+
+
+void wsb_add_char(wstr_builder* sb, wchar_t c)
+{
+  wsb_add_n(sb, &c, 1);
+}
+
+
+void wsb_add_utf8(wstr_builder* sb, const char* s)
+{
+  int n;
+
+  if (!sb || !s || !sb->cap)
+    return;
+
+  n = ConvertFromUTF8(sb->buf + sb->len, s, sb->cap - sb->len);
+  sb->len += n;
+  /* A conversion that fills the buffer may have been cut short */
+  if (sb->len + 1 >= sb->cap && *s)
+    sb->truncated = 1;
+  sb->buf[sb->len] = L'\0';
+}
+
+
+wchar_t* wsb_str(wstr_builder* sb)
+{
+  static wchar_t empty[1] = {L'\0'};
+
+  if (!sb || !sb->cap)
+    return empty;
+  return sb->buf;
 }
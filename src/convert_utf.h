@@ -2,7 +2,7 @@
    convert_utf.h:
 
    Description: header file for simple wrapper functions to convert
-   wchar_t and utf8 strings using GNU iconv().
+   wchar_t and utf8 strings.
    
    Copyright 2009, 2010.
    Author: David Bruce.
@@ -34,11 +34,32 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 /* NOTE the "max_length" parameter should generally be the size of the output     */
 /* buffer.  It must be at least one greater than the length of the return string  */
-/* so that the string can be null-terminated.                                     */
-/* Also, "max_length" must be no greater than the buffer length used internally   */
-/* in these functions (i.e. UTF_BUF_LENGTH, currently 1024)                       */
+/* so that the string can be null-terminated - longer strings are truncated.      */
+/* Both functions return the length of the converted string.  Invalid input is    */
+/* reported on stderr and the part converted before the error is kept, so the     */
+/* return value is never negative.  ConvertFromUTF8Strict() instead returns -1    */
+/* and leaves "wide_word" empty if the input is not valid UTF-8.                  */
 
 int ConvertFromUTF8(wchar_t* wide_word, const char* UTF8_word, int max_length);
+int ConvertFromUTF8Strict(wchar_t* wide_word, const char* UTF8_word, int max_length);
 int ConvertToUTF8(const wchar_t* wide_word, char* UTF8_word, int max_length);
 
+/* Bounds-checked wide string builder over caller-supplied storage, used to   */
+/* compose speech strings without allocating.  Appends that do not fit are    */
+/* cut off and set "truncated"; the buffer is always null-terminated.         */
+typedef struct wstr_builder {
+  wchar_t* buf;
+  size_t len;
+  size_t cap;
+  int truncated;
+} wstr_builder;
+
+void wsb_init(wstr_builder* sb, wchar_t* storage, size_t cap);
+void wsb_reset(wstr_builder* sb);
+void wsb_add_char(wstr_builder* sb, wchar_t c);
+void wsb_add(wstr_builder* sb, const wchar_t* s);
+void wsb_add_n(wstr_builder* sb, const wchar_t* s, size_t n);
+void wsb_add_utf8(wstr_builder* sb, const char* s);
+wchar_t* wsb_str(wstr_builder* sb);
+
 #endif
@@ -677,12 +677,12 @@ void EditWordList(char* words_file)
 
           if (event.key.keysym.sym == SDLK_BACKSPACE)
           {
-            len = ConvertFromUTF8(temp, words_in_list[loc+1], MAX_WORD_SIZE); 
+            len = ConvertFromUTF8(temp, words_in_list[loc+1], sizeof(temp) / sizeof(temp[0])); 
             if (len > 1 && number_of_words > 1)
             {                               
               // remove the last character from the string
               temp[len - 1] = temp[len];
-              len = ConvertToUTF8(temp, words_in_list[loc+1], MAX_WORD_SIZE);
+              len = ConvertToUTF8(temp, words_in_list[loc+1], sizeof(words_in_list[0]));
               white_words[loc] = BlackOutline(words_in_list[loc+1], DEFAULT_MENU_FONT_SIZE, &white );
               yellow_words[loc] = BlackOutline(words_in_list[loc+1], DEFAULT_MENU_FONT_SIZE, &yellow);  
             }
@@ -707,7 +707,7 @@ void EditWordList(char* words_file)
                 {
                   if(x < number_of_words-1)
                   {
-                    len = ConvertFromUTF8(temp, words_in_list[x+2], MAX_WORD_SIZE);
+                    len = ConvertFromUTF8(temp, words_in_list[x+2], sizeof(temp) / sizeof(temp[0]));
 
                     DEBUGCODE
                     {
@@ -716,7 +716,7 @@ void EditWordList(char* words_file)
                       fprintf(stderr, "word in list = %s\n", words_in_list[x+2]);
                     }
 
-                    len = ConvertToUTF8(temp, words_in_list[x+1], MAX_WORD_SIZE);
+                    len = ConvertToUTF8(temp, words_in_list[x+1], sizeof(words_in_list[0]));
 
                     DEBUGCODE
                     { fprintf(stderr, "word in list = %s\n", words_in_list[x+1]); }
@@ -839,14 +839,14 @@ void EditWordList(char* words_file)
             }
             else
             {
-              len = ConvertFromUTF8(temp, words_in_list[loc + 1], MAX_WORD_SIZE);
+              len = ConvertFromUTF8(temp, words_in_list[loc + 1], sizeof(temp) / sizeof(temp[0]));
             }
             if (len < MAX_WORD_SIZE - 1)
             {
               // Add the character to the end of the existing string
               temp[len] = toupper(event.key.keysym.unicode);
               temp[len + 1] = 0;
-              ConvertToUTF8(temp, words_in_list[loc + 1], MAX_WORD_SIZE);
+              ConvertToUTF8(temp, words_in_list[loc + 1], sizeof(words_in_list[0]));
 
               // Copy back to the on-screen list
               white_words[loc] = BlackOutline(words_in_list[loc + 1],
@@ -1079,7 +1079,7 @@ int CreateNewWordList(void)
           switch (event.key.keysym.sym)
           {
             case SDLK_BACKSPACE:
-              len = ConvertFromUTF8(temp, wordlist, MAX_WORD_SIZE);
+              len = ConvertFromUTF8(temp, wordlist, sizeof(temp) / sizeof(temp[0]));
               if (len < 1)
               {
                 LOG("There are no letters to delete\n");
@@ -1087,7 +1087,7 @@ int CreateNewWordList(void)
               else
               {
                 temp[len - 1] = temp[len];
-                len = ConvertToUTF8(temp, wordlist, MAX_WORD_SIZE);
+                len = ConvertToUTF8(temp, wordlist, sizeof(wordlist));
                 NewWordlist = BlackOutline(wordlist, DEFAULT_MENU_FONT_SIZE, &yellow);
                 DEBUGCODE{ fprintf(stderr, "Word: %s\n", wordlist); }
               }
@@ -1122,14 +1122,14 @@ int CreateNewWordList(void)
           {
             DEBUGCODE { fprintf(stderr, "TEMP 1: %s\n", wordlist); }
 
-            len = ConvertFromUTF8(temp, wordlist, MAX_WORD_SIZE);
+            len = ConvertFromUTF8(temp, wordlist, sizeof(temp) / sizeof(temp[0]));
             if (len < MAX_WORD_SIZE)
             {
               // adds a character to the end of existing string
               temp[len] = toupper(event.key.keysym.unicode);
               temp[len + 1] = 0;
             }
-            len = ConvertToUTF8(temp, wordlist, MAX_WORD_SIZE);
+            len = ConvertToUTF8(temp, wordlist, sizeof(wordlist));
 
             DEBUGCODE { fprintf(stderr, "TEMP 2: %s\n", wordlist); }
 
@@ -40,6 +40,7 @@ void GenCharListFromString(const char* UTF8_str);
 void ResetCharList(void);
 wchar_t GetLetter(void);
 wchar_t* GetWord(void);
+wchar_t* GetWordMaxLen(int max_len);
 SDL_Surface* GetWhiteGlyph(wchar_t t);
 SDL_Surface* GetRedGlyph(wchar_t t);
 int LoadKeyboard(void);
@@ -78,6 +79,9 @@ SDL_Surface* LoadImage(const char* datafile, int mode);
 int LoadBothBkgds(const char* datafile);
 SDL_Surface* CurrentBkgd(void);
 void FreeBothBkgds(void);
+void ReleaseInactiveBkgd(void);
+int PrefetchBkgd(const char* datafile);
+void CancelBkgdPrefetch(void);
 void LoadLang(void);
 Mix_Music* LoadMusic(const char* datafile);
 Mix_Chunk* LoadSound(const char* datafile);
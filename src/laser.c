@@ -31,6 +31,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "globals.h"
 #include "funcs.h"
 #include "SDL_extras.h"
+#include "braille.h"
+#include "convert_utf.h"
+#include "announcer.h"
 #include "laser.h"
 
 
@@ -43,6 +46,27 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define LASER_START 5
 #define NUM_ANS 8
 #define COMET_ZAP_FONT_SIZE 32
+#define MAX_NUM_DIGITS 10
+#define LASER_THICK_W 3   /* width and height of the "brush" used to */
+#define LASER_THICK_H 4   /* draw the laser beam                     */
+
+/* Slots in a scene, in the order they are drawn (the laser beam goes  */
+/* between the cities and the console). Each object on the screen      */
+/* always uses the same slot, so comparing a slot with its value from  */
+/* the previous frame tells us whether that object needs repainting:   */
+enum {
+  SLOT_WAVE_LABEL,
+  SLOT_WAVE_DIGITS,
+  SLOT_SCORE_LABEL = SLOT_WAVE_DIGITS + MAX_NUM_DIGITS,
+  SLOT_SCORE_DIGITS,
+  SLOT_COMETS = SLOT_SCORE_DIGITS + MAX_NUM_DIGITS,
+  SLOT_LETTERS = SLOT_COMETS + MAX_COMETS,
+  SLOT_CITIES = SLOT_LETTERS + MAX_COMETS,  /* city, shield, city, ... */
+  SLOT_CONSOLE = SLOT_CITIES + 2 * NUM_CITIES,
+  SLOT_TUX,
+  SLOT_GAMEOVER,
+  NUM_SLOTS
+};
 
 /* Local (to laser.c) 'globals': */
 static sprite* shield = NULL;
@@ -62,24 +86,33 @@ static comet_type comets[MAX_COMETS];
 static city_type cities[NUM_CITIES];
 static laser_type laser;
 
-static int tts_announcer_switch = 1;
 static int braille_letter_pos = 0;
 
+/* What was drawn in the last two frames, so we only repaint what changed: */
+static scene_blit scenes[2][NUM_SLOTS];
+static int cur_scene = 0;
+static laser_type drawn_laser;
+static int full_redraw = 1;
+
 /* Local function prototypes: */
 static void laser_add_comet(int diff_level);
 static void laser_add_score(int inc);
-static void laser_draw_console_image(int i);
-static void laser_draw_let(wchar_t c, int x, int y);
+static void laser_build_scene(scene_blit* scene, int frame, int tux_img, int gameover);
 static void laser_draw_line(int x1, int y1, int x2, int y2, int r, int g, int b);
-static void laser_draw_numbers(const char* str, int x);
+static void laser_draw_scene(scene_blit* scene, const SDL_Rect* area);
+static void laser_fill_rect(SDL_Surface* surface, int x, int y, int w, int h, Uint32 pixel);
+static void laser_line_rect(laser_type* l, SDL_Rect* r);
+static int laser_rects_touch(const SDL_Rect* a, const SDL_Rect* b);
+static int laser_split_rects(const SDL_Rect* in, int n, SDL_Rect* out, int max_out);
+static void laser_set_numbers(scene_blit* slots, const char* str, int x);
+static void laser_set_slot(scene_blit* slot, SDL_Surface* src, SDL_Rect* srcrect, int x, int y);
+static void laser_update_screen(int frame, int tux_img, int gameover);
 static void laser_load_data(void);
 static void laser_reset_level(int diff_level);
-static void laser_putpixel(SDL_Surface* surface, int x, int y, Uint32 pixel);
 static void laser_unload_data(void);
 static void calc_city_pos(void);
 static void recalc_comet_pos(void);
-static void stop_tts_announcer();
-static int tts_announcer(void *unused);
+static void queue_announcements(void);
 
 
 
@@ -89,7 +122,7 @@ static int tts_announcer(void *unused);
 
 int PlayLaserGame(int diff_level)
 {
-	int i, img, done, quit, frame, lowest, lowest_y, 
+	int i, done, quit, frame, lowest, lowest_y, 
 	    tux_img, old_tux_img, tux_pressing, tux_anim, tux_anim_frame,
 	    tux_same_counter, level_start_wait,
 	    num_comets_alive, paused, picked_comet, 
@@ -97,7 +130,6 @@ int PlayLaserGame(int diff_level)
 	  
 
 	//TTS Word announcer variables
-	SDL_Thread *thread;
 
 	//Braille Variables
 	wchar_t pressed_letters[1000];
@@ -109,9 +141,6 @@ int PlayLaserGame(int diff_level)
 	Uint32 last_time = 0;
         Uint32 now_time = 0;
 	SDLKey    key;
-	SDL_Rect  src, dest;
-	/* str[] is a buffer to draw the scores, waves, etc. (don't need wchar_t) */
-	char str[64]; 
 
 	LOG( "starting Comet Zap game\n" );
 	DOUT( diff_level );
@@ -128,7 +157,6 @@ int PlayLaserGame(int diff_level)
 
 	done = 0;
 	quit = 0;
-	src.w = src.h = 0;
 
 	/* Prepare to start the game: */
   
@@ -166,6 +194,8 @@ int PlayLaserGame(int diff_level)
   
 	frame = 0;
 	paused = 0;
+	full_redraw = 1;
+	drawn_laser.alive = 0;
 	picked_comet = -1;
 	tux_img = IMG_TUX_RELAX1;
 	tux_anim = -1;
@@ -177,9 +207,9 @@ int PlayLaserGame(int diff_level)
 	
 
 
-	 //Call announcer function in thread which annonces the word to type 
+	 //Start the thread which annonces the word to type 
 	if(settings.tts)
-		thread = SDL_CreateThread(tts_announcer, NULL);	
+		StartAnnouncer();
 	
 	//Inetialising braille variables
 	braille_iter = 0;
@@ -211,6 +241,7 @@ int PlayLaserGame(int diff_level)
 				  SwitchScreenMode();
                                   calc_city_pos();
                                   recalc_comet_pos();
+                                  full_redraw = 1;
                                 }
 				if (key == SDLK_F11)
 					SDL_SaveBMP( screen, "laser.bmp");
@@ -222,15 +253,24 @@ int PlayLaserGame(int diff_level)
 					paused = 1;
 				/* Score */
 				if(key == SDLK_F1)
-					tts_announcer_switch = 2;
+				{
+					ClearAnnouncements();
+					AnnounceCount("Score %d!",score);
+				}
 				
 				/* iglu alive */
 				if(key == SDLK_F2)
-					tts_announcer_switch = 3;
+				{
+					ClearAnnouncements();
+					AnnounceCount("%d cities alive!",num_cities_alive);
+				}
 				
 				/* Wave number */
 				if(key == SDLK_F3)
-					tts_announcer_switch = 4;
+				{
+					ClearAnnouncements();
+					AnnounceCount("on wave %d!",wave);
+				}
 
 				/* --- eat other keys until level wait has passed --- */ 
 				if (level_start_wait > 0) 
@@ -278,29 +318,26 @@ int PlayLaserGame(int diff_level)
 				/* ----- SDL_KEYUP is Only for Braille Mode -------------*/
 				if(settings.braille)
 				{
-					arrange_in_order(pressed_letters);
-				    if (wcscmp(pressed_letters,L"") != 0)
+					struct braille_dict* chord_entry;
+					/* Every character sharing this chord is tried: */
+					for (chord_entry = braille_chord_lookup(braille_chord_from_keys(pressed_letters));
+					     chord_entry && ans_num < NUM_ANS;
+					     chord_entry = braille_chord_next(chord_entry))
 				    {
-					   for(i=0;i<100;i++)
+					   if (settings.use_english)
 					   {
-						   if (wcscmp(pressed_letters,braille_key_value_map[i].key) == 0)
-						   {
-							   if (settings.use_english)
-							   {
-								   /* English have no such rules */
-							   	   ans[ans_num++] = toupper(braille_key_value_map[i].value_begin[0]);
-							   }
-							   else
-							   {
-							   		if (braille_letter_pos == 0)
-								   	   ans[ans_num++] = braille_key_value_map[i].value_begin[0];
-								    else if (braille_letter_pos == 1)
-									   ans[ans_num++] = braille_key_value_map[i].value_middle[0];
-								    else
-									   ans[ans_num++] = braille_key_value_map[i].value_end[0];
-							   }			   
-						   }
-					   }	   
+						   /* English have no such rules */
+					   	   ans[ans_num++] = toupper(chord_entry->value_begin[0]);
+					   }
+					   else
+					   {
+					   		if (braille_letter_pos == 0)
+						   	   ans[ans_num++] = chord_entry->value_begin[0];
+						    else if (braille_letter_pos == 1)
+							   ans[ans_num++] = chord_entry->value_middle[0];
+						    else
+							   ans[ans_num++] = chord_entry->value_end[0];
+					   }
 				   }
 				   
 				   braille_iter = 0;
@@ -607,161 +644,35 @@ int PlayLaserGame(int diff_level)
                 if ((num_cities_alive==0) && (gameover == 0))
                 {
                     gameover = GAMEOVER_COUNTER_START;
-                    if(settings.tts)
-						stop_tts_announcer();
+                    ClearAnnouncements();
 					T4K_Tts_say(DEFAULT_VALUE,DEFAULT_VALUE,INTERRUPT,gettext("yep you miss it. hahh hahh haa. game over! you scored %d goodbye!"),score);
 					
 				}
       
-		/* Draw background: */
-     
-		SDL_BlitSurface(CurrentBkgd(), NULL, screen, NULL);
+		/* Draw everything that changed since the last frame: */
 
-		/* Draw wave: */
-
-		dest.x = 0;
-		dest.y = 0;
-		dest.w = images[IMG_WAVE]->w;
-		dest.h = images[IMG_WAVE]->h;
-
-		SDL_BlitSurface(images[IMG_WAVE], NULL, screen, &dest);
-
-		sprintf(str, "%d", wave);
-		laser_draw_numbers(str, images[IMG_WAVE]->w + (images[IMG_NUMBERS]->w / 10));
-
-
-		/* Draw score: */
-
-		dest.x = (screen->w - ((images[IMG_NUMBERS]->w / 10) * 7) - images[IMG_SCORE]->w);
-		dest.y = 0;
-		dest.w = images[IMG_SCORE]->w;
-		dest.h = images[IMG_SCORE]->h;
-
-		SDL_BlitSurface(images[IMG_SCORE], NULL, screen, &dest);
-      
-		sprintf(str, "%.6d", score);
-		laser_draw_numbers(str, screen->w - ((images[IMG_NUMBERS]->w / 10) * 6));
-      
-      
-		/* Draw comets: */
-      
-		for (i = 0; i < MAX_COMETS; i++) 
-			if (comets[i].alive) {
-
-				/* Decide which image to display: */
-				if (comets[i].expl == 0)
-					img = IMG_COMET1 + ((frame + i) % 3);
-				else
-					img = (IMG_COMETEX2 - (comets[i].expl / (COMET_EXPL_START / 2)));
-	      
-
-				/* Draw it! */
-
-				dest.x = comets[i].x - (images[img]->w / 2);
-				dest.y = comets[i].y - images[img]->h;
-				dest.w = images[img]->w;
-				dest.h = images[img]->h;
-	      
-				SDL_BlitSurface(images[img], NULL, screen, &dest);
-			}
-
-
-		/* Draw letters: */
-
-		for (i = 0; i < MAX_COMETS; i++)
-			if (comets[i].alive && comets[i].expl == 0)
-				laser_draw_let(comets[i].ch, comets[i].x, comets[i].y);
-      
-		/* Draw cities: */
-      
 		if (frame%2 == 0) NEXT_FRAME(shield);
-		for (i = 0; i < NUM_CITIES; i++) {
-
-			/* Decide which image to display: */
-	 
-			if (cities[i].alive) {
-				if (cities[i].expl == 0)
-					img = IMG_CITY_BLUE;
-				else
-					img = (IMG_CITY_BLUE_EXPL5 - (cities[i].expl / (CITY_EXPL_START / 5)));
-			} else 
-				img = IMG_CITY_BLUE_DEAD;
-	  
-	  
-			/* Change image to appropriate color: */
-	  
-			img += ((wave % MAX_CITY_COLORS) * (IMG_CITY_GREEN - IMG_CITY_BLUE));
-	  
-	  
-			/* Draw it! */
-	  
-			dest.x = cities[i].x - (images[img]->w / 2);
-			dest.y = (screen->h) - (images[img]->h);
-			dest.w = (images[img]->w);
-			dest.h = (images[img]->h);
-	  
-			SDL_BlitSurface(images[img], NULL, screen, &dest);
-
-			/* Draw sheilds: */
-
-			if (cities[i].shields) {
-
-				dest.x = cities[i].x - (shield->frame[shield->cur]->w / 2);
-				dest.h = (screen->h) - (shield->frame[shield->cur]->h);
-				dest.w = src.w;
-				dest.h = src.h;
-				SDL_BlitSurface( shield->frame[shield->cur], NULL, screen, &dest);
-
-			}
-		}
-
-
-		/* Draw laser: */
-
-		if (laser.alive)
-			laser_draw_line(laser.x1, laser.y1, laser.x2, laser.y2, 255 / (LASER_START - laser.alive),
-			                192 / (LASER_START - laser.alive), 64);
-
-		laser_draw_console_image(IMG_CONSOLE);
 
 		if (gameover > 0)
 			tux_img = IMG_TUX_FIST1 + ((frame / 2) % 2);
 
-		laser_draw_console_image(tux_img);
-
+		laser_update_screen(frame, tux_img, gameover);
 
-		/* Draw "Game Over" */
-
-		if (gameover > 0) {
-
-			dest.x = (screen->w - images[IMG_GAMEOVER]->w) / 2;
-			dest.y = (screen->h - images[IMG_GAMEOVER]->h) / 2;
-			dest.w = images[IMG_GAMEOVER]->w;
-			dest.h = images[IMG_GAMEOVER]->h;
-	
-			SDL_BlitSurface(images[IMG_GAMEOVER], NULL, screen, &dest);
-		}
-      
-      
-		/* Swap buffers: */
-      
-		SDL_Flip(screen);
+		if (settings.tts && gameover == 0)
+			queue_announcements();
 
 
 		/* If we're in "PAUSE" mode, pause! */
 
 		if (paused) {
-			if(settings.tts)
-				stop_tts_announcer();
+			ClearAnnouncements();
 			T4K_Tts_say(DEFAULT_VALUE,DEFAULT_VALUE,INTERRUPT,gettext("Game Paused!"));
 			quit = Pause();
 			if(quit == 0){
 					T4K_Tts_say(DEFAULT_VALUE,DEFAULT_VALUE,INTERRUPT,gettext("Pause Released!"));
-					//Call announcer function in thread which annonces the word to type
-					if(settings.tts)
-						thread = SDL_CreateThread(tts_announcer, NULL);
 			}							
 			paused = 0;
+			full_redraw = 1;
 		}
 
       
@@ -783,8 +694,10 @@ int PlayLaserGame(int diff_level)
 	}
 	while (!done && !quit);
 
+  StopAnnouncer();
   
   /* Free backgrounds: */
+  CancelBkgdPrefetch();
   FreeBothBkgds();
 
   /* Stop music: */
@@ -885,6 +798,7 @@ static void laser_reset_level(int diff_level)
 {
   char fname[1024];
   static int last_bkgd = -1;
+  static int next_bkgd = -1;  // already being loaded, if >= 0
   int i;
   
   /* Clear all comets: */
@@ -895,11 +809,17 @@ static void laser_reset_level(int diff_level)
   /* Load diffrent random background image: */
   LOG("Loading background in laser_reset_level()\n");
 
-  do {
-    i = rand() % NUM_BKGDS;
-    DOUT(i);
+  /* Use the background picked (and prefetched) last time if there is one: */
+  if (next_bkgd >= 0 && next_bkgd != last_bkgd)
+    i = next_bkgd;
+  else
+  {
+    do {
+      i = rand() % NUM_BKGDS;
+      DOUT(i);
+    }
+    while (i == last_bkgd);
   }
-  while (i == last_bkgd);
 
   last_bkgd = i;
 
@@ -912,6 +832,7 @@ static void laser_reset_level(int diff_level)
   FreeBothBkgds(); // LoadBothBkgds() actually does this just in case
 
   LoadBothBkgds(fname);
+  full_redraw = 1;
 
   if (CurrentBkgd() == NULL)
   {
@@ -922,6 +843,15 @@ static void laser_reset_level(int diff_level)
      fname, SDL_GetError());
   }
 
+  /* Pick the next wave's background now and load it during this wave: */
+  do {
+    next_bkgd = rand() % NUM_BKGDS;
+  }
+  while (next_bkgd == last_bkgd);
+
+  sprintf(fname, "backgrounds/%d.jpg", next_bkgd);
+  PrefetchBkgd(fname);
+
   /* Record score before this wave: */
 
   pre_wave_score = score;
@@ -997,7 +927,7 @@ static void laser_add_comet(int diff_level)
 	else /* Odd number of cities (is this a hack that means we are using words?) */
         {
           LOG("NUM_CITIES is odd\n");
-          wchar_t* word = GetWord();
+          wchar_t* word = GetWordMaxLen(NUM_CITIES - 1);
           int i = 0;
           comet_type* prev_comet = NULL;
 
@@ -1005,7 +935,7 @@ static void laser_add_comet(int diff_level)
              || (wcslen(word) == 0)
              || (wcslen(word) > NUM_CITIES - 1))
           {
-            fprintf(stderr, "Error - GetWord() returned NULL, zero-length, or too-long word\n");
+            fprintf(stderr, "Error - GetWordMaxLen() found no word short enough\n");
             return; 
           }
 
@@ -1052,201 +982,518 @@ static void laser_add_comet(int diff_level)
 }
 
 
-/* Draw numbers/symbols over the attacker: */
+/* Fill in 'slot' to draw 'src' (or the 'srcrect' part of it, if not  */
+/* NULL) with its upper left corner at (x, y):                         */
+static void laser_set_slot(scene_blit* slot, SDL_Surface* src, SDL_Rect* srcrect, int x, int y)
+{
+  slot->src = src;
+  if (!src)
+    return;
+
+  if (srcrect)
+    slot->srcrect = *srcrect;
+  else
+  {
+    slot->srcrect.x = 0;
+    slot->srcrect.y = 0;
+    slot->srcrect.w = src->w;
+    slot->srcrect.h = src->h;
+  }
+
+  slot->dstrect.x = x;
+  slot->dstrect.y = y;
+  slot->dstrect.w = slot->srcrect.w;
+  slot->dstrect.h = slot->srcrect.h;
+}
+
 
-static void laser_draw_let(wchar_t c, int x, int y)
+/* Status numbers - one slot per digit, starting at 'slots': */
+
+static void laser_set_numbers(scene_blit* slots, const char* str, int x)
 {
-  /* Draw letter in correct place relative to comet: */
-  const int offset_x = -10; /* Values determined by trial and error: */
-  const int offset_y = -50;
+  int i, n, c;
+  SDL_Rect src;
+
+  src.y = 0;
+  src.w = (images[IMG_NUMBERS]->w / 10);
+  src.h = images[IMG_NUMBERS]->h;
+
+  for (i = 0, n = 0; str[i] && n < MAX_NUM_DIGITS; i++)
+  {
+    /* Only digits are in the image: */
+    if (str[i] < '0' || str[i] > '9')
+      continue;
+
+    c = str[i] - '0';
+    src.x = c * src.w;
+    laser_set_slot(&slots[n], images[IMG_NUMBERS], &src, x + n * src.w, 0);
+    n++;
+  }
+}
+
 
-  SDL_Rect dst;
+/* laser_build_scene() works out everything to be drawn this frame,   */
+/* without drawing anything:                                          */
+
+static void laser_build_scene(scene_blit* scene, int frame, int tux_img, int gameover)
+{
+  /* Draw letter in correct place relative to comet: */
+  const int let_offset_x = -10; /* Values determined by trial and error: */
+  const int let_offset_y = -50;
+  /* str[] is a buffer to draw the scores, waves, etc. (don't need wchar_t) */
+  char str[64];
+  int i, img;
   SDL_Surface* s;
-  dst.x = x + offset_x;
-  dst.y = y + offset_y;
-  s = GetWhiteGlyph(c);
-  if (s)
-    SDL_BlitSurface(s, NULL, screen, &dst); 
+
+  memset(scene, 0, NUM_SLOTS * sizeof(scene_blit));
+
+  /* Wave: */
+  laser_set_slot(&scene[SLOT_WAVE_LABEL], images[IMG_WAVE], NULL, 0, 0);
+  sprintf(str, "%d", wave);
+  laser_set_numbers(&scene[SLOT_WAVE_DIGITS], str,
+                    images[IMG_WAVE]->w + (images[IMG_NUMBERS]->w / 10));
+
+  /* Score: */
+  laser_set_slot(&scene[SLOT_SCORE_LABEL], images[IMG_SCORE], NULL,
+                 screen->w - ((images[IMG_NUMBERS]->w / 10) * 7) - images[IMG_SCORE]->w,
+                 0);
+  sprintf(str, "%.6d", score);
+  laser_set_numbers(&scene[SLOT_SCORE_DIGITS], str,
+                    screen->w - ((images[IMG_NUMBERS]->w / 10) * 6));
+
+  /* Comets, and their letters: */
+  for (i = 0; i < MAX_COMETS; i++)
+  {
+    if (!comets[i].alive)
+      continue;
+
+    /* Decide which image to display: */
+    if (comets[i].expl == 0)
+      img = IMG_COMET1 + ((frame + i) % 3);
+    else
+      img = (IMG_COMETEX2 - (comets[i].expl / (COMET_EXPL_START / 2)));
+
+    laser_set_slot(&scene[SLOT_COMETS + i], images[img], NULL,
+                   comets[i].x - (images[img]->w / 2),
+                   comets[i].y - images[img]->h);
+
+    if (comets[i].expl == 0)
+    {
+      s = GetWhiteGlyph(comets[i].ch);
+      laser_set_slot(&scene[SLOT_LETTERS + i], s, NULL,
+                     comets[i].x + let_offset_x, comets[i].y + let_offset_y);
+    }
+  }
+
+  /* Cities, each followed by its shield: */
+  for (i = 0; i < NUM_CITIES; i++)
+  {
+    /* Decide which image to display: */
+    if (cities[i].alive)
+    {
+      if (cities[i].expl == 0)
+        img = IMG_CITY_BLUE;
+      else
+        img = (IMG_CITY_BLUE_EXPL5 - (cities[i].expl / (CITY_EXPL_START / 5)));
+    }
+    else
+      img = IMG_CITY_BLUE_DEAD;
+
+    /* Change image to appropriate color: */
+    img += ((wave % MAX_CITY_COLORS) * (IMG_CITY_GREEN - IMG_CITY_BLUE));
+
+    laser_set_slot(&scene[SLOT_CITIES + 2 * i], images[img], NULL,
+                   cities[i].x - (images[img]->w / 2),
+                   (screen->h) - (images[img]->h));
+
+    /* The shield goes at the same height as the top of the city: */
+    if (cities[i].shields)
+      laser_set_slot(&scene[SLOT_CITIES + 2 * i + 1], shield->frame[shield->cur], NULL,
+                     cities[i].x - (shield->frame[shield->cur]->w / 2),
+                     (screen->h) - (images[img]->h));
+  }
+
+  /* Console and Tux at lower center of screen: */
+  laser_set_slot(&scene[SLOT_CONSOLE], images[IMG_CONSOLE], NULL,
+                 (screen->w - images[IMG_CONSOLE]->w) / 2,
+                 (screen->h - images[IMG_CONSOLE]->h));
+  laser_set_slot(&scene[SLOT_TUX], images[tux_img], NULL,
+                 (screen->w - images[tux_img]->w) / 2,
+                 (screen->h - images[tux_img]->h));
+
+  /* "Game Over": */
+  if (gameover > 0)
+    laser_set_slot(&scene[SLOT_GAMEOVER], images[IMG_GAMEOVER], NULL,
+                   (screen->w - images[IMG_GAMEOVER]->w) / 2,
+                   (screen->h - images[IMG_GAMEOVER]->h) / 2);
 }
 
 
-/* Draw status numbers: */
+/* Paint the background and the scene. If 'area' is not NULL, only   */
+/* that part of the screen is repainted (it must also be the clip     */
+/* rect), and anything entirely outside it is skipped:                */
 
-static void laser_draw_numbers(const char* str, int x)
+static void laser_draw_scene(scene_blit* scene, const SDL_Rect* area)
 {
-  int i, cur_x, c;
   SDL_Rect src, dest;
+  int i;
+
+  if (area)
+  {
+    src = dest = *area;
+    SDL_BlitSurface(CurrentBkgd(), &src, screen, &dest);
+  }
+  else
+    SDL_BlitSurface(CurrentBkgd(), NULL, screen, NULL);
+
+  for (i = 0; i < NUM_SLOTS; i++)
+  {
+    /* Laser goes on top of the cities, under the console: */
+    if (i == SLOT_CONSOLE && laser.alive)
+    {
+      laser_line_rect(&laser, &dest);
+      if (!area || laser_rects_touch(area, &dest))
+        laser_draw_line(laser.x1, laser.y1, laser.x2, laser.y2, 255 / (LASER_START - laser.alive),
+                        192 / (LASER_START - laser.alive), 64);
+    }
 
-  cur_x = x;
+    if (!scene[i].src)
+      continue;
+    if (area && !laser_rects_touch(area, &scene[i].dstrect))
+      continue;
 
+    /* SDL_BlitSurface() changes dest, and we need to keep the original: */
+    dest = scene[i].dstrect;
+    SDL_BlitSurface(scene[i].src, &scene[i].srcrect, screen, &dest);
+  }
+}
 
-  /* Draw each character: */
-  
-  for (i = 0; i < strlen(str); i++)
+
+/* Area of the screen covered by laser beam 'l': */
+
+static void laser_line_rect(laser_type* l, SDL_Rect* r)
+{
+  r->x = (l->x1 < l->x2) ? l->x1 : l->x2;
+  r->y = (l->y1 < l->y2) ? l->y1 : l->y2;
+  r->w = abs(l->x2 - l->x1) + LASER_THICK_W;
+  r->h = abs(l->y2 - l->y1) + LASER_THICK_H;
+}
+
+
+/* Nonzero if 'a' and 'b' share any pixels: */
+
+static int laser_rects_touch(const SDL_Rect* a, const SDL_Rect* b)
+{
+  return a->x < b->x + b->w && b->x < a->x + a->w
+      && a->y < b->y + b->h && b->y < a->y + a->h;
+}
+
+
+/* Copies the 'n' rects in 'in' to 'out' with the overlaps cut away, so */
+/* no pixel is in more than one of them. A rect that overlaps one       */
+/* already in 'out' is split into the (up to four) pieces outside it.   */
+/* 'max_out' must be at least 'n'; if there isn't room to split a rect  */
+/* it is kept whole, which is still correct, just slower.               */
+/* Returns the number of rects in 'out':                                */
+
+static int laser_split_rects(const SDL_Rect* in, int n, SDL_Rect* out, int max_out)
+{
+  int i, j, k, count = 0;
+
+  for (i = 0; i < n && count < max_out; i++)
+  {
+    int first = count;
+
+    out[count++] = in[i];
+
+    /* Cut each earlier rect out of the pieces of this one: */
+    for (j = 0; j < first; j++)
     {
-      c = -1;
+      for (k = first; k < count; k++)
+      {
+        SDL_Rect p = out[k];
+        const SDL_Rect* o = &out[j];
+        int top, bottom;
 
-      /* Determine which character to display: */
-      
-      if (str[i] >= '0' && str[i] <= '9')
-	c = str[i] - '0';
-      
+        if (!laser_rects_touch(&p, o))
+          continue;
 
-      /* Display this character! */
-      
-      if (c != -1)
-	{
-	  src.x = c * (images[IMG_NUMBERS]->w / 10);
-	  src.y = 0;
-	  src.w = (images[IMG_NUMBERS]->w / 10);
-	  src.h = images[IMG_NUMBERS]->h;
-	  
-	  dest.x = cur_x;
-	  dest.y = 0;
-	  dest.w = src.w;
-	  dest.h = src.h;
-	  
-	  SDL_BlitSurface(images[IMG_NUMBERS], &src,
-			  screen, &dest);
+        /* Not enough room for the pieces (leaving one for each rect */
+        /* still to come) - keep it whole:                           */
+        if (count + 3 + (n - i - 1) > max_out)
+          continue;
 
+        /* Replace p by the parts above, below, left and right of o: */
+        out[k] = out[--count];
+        k--;
 
-          /* Move the 'cursor' one character width: */
+        top = (o->y > p.y) ? o->y : p.y;
+        bottom = (o->y + o->h < p.y + p.h) ? o->y + o->h : p.y + p.h;
 
-	  cur_x = cur_x + (images[IMG_NUMBERS]->w / 10);
-	}
+        if (o->y > p.y)
+        {
+          out[count].x = p.x;  out[count].y = p.y;
+          out[count].w = p.w;  out[count].h = o->y - p.y;
+          count++;
+        }
+        if (o->y + o->h < p.y + p.h)
+        {
+          out[count].x = p.x;  out[count].y = o->y + o->h;
+          out[count].w = p.w;  out[count].h = p.y + p.h - (o->y + o->h);
+          count++;
+        }
+        if (o->x > p.x)
+        {
+          out[count].x = p.x;  out[count].y = top;
+          out[count].w = o->x - p.x;  out[count].h = bottom - top;
+          count++;
+        }
+        if (o->x + o->w < p.x + p.w)
+        {
+          out[count].x = o->x + o->w;  out[count].y = top;
+          out[count].w = p.x + p.w - (o->x + o->w);  out[count].h = bottom - top;
+          count++;
+        }
+      }
     }
+  }
+
+  return count;
 }
 
+
+/* laser_update_screen() draws this frame's scene, but only repaints the    */
+/* parts of the screen that differ from the last frame. Every changed area  */
+/* is repainted bottom to top (background first), so static things like    */
+/* the cities and console are restored correctly under moving comets.       */
+/* Set 'full_redraw' whenever the whole screen may have changed (new        */
+/* background, screen mode switch, pause screen):                           */
+
+static void laser_update_screen(int frame, int tux_img, int gameover)
+{
+  scene_blit* old = scenes[cur_scene];
+  scene_blit* cur = scenes[!cur_scene];
+  SDL_Rect dirty[2 * NUM_SLOTS + 2];
+  SDL_Rect areas[4 * (2 * NUM_SLOTS + 2)];
+  int i, n = 0;
+
+  laser_build_scene(cur, frame, tux_img, gameover);
+
+  if (full_redraw)
+  {
+    SDL_SetClipRect(screen, NULL);
+    laser_draw_scene(cur, NULL);
+    SDL_Flip(screen);
+    full_redraw = 0;
+  }
+  else
+  {
+    /* Anything that moved or changed needs both old and new areas redrawn: */
+    for (i = 0; i < NUM_SLOTS; i++)
+    {
+      if (old[i].src == cur[i].src
+       && (!cur[i].src
+           || (memcmp(&old[i].srcrect, &cur[i].srcrect, sizeof(SDL_Rect)) == 0
+            && memcmp(&old[i].dstrect, &cur[i].dstrect, sizeof(SDL_Rect)) == 0)))
+        continue;
+
+      if (old[i].src)
+        dirty[n++] = old[i].dstrect;
+      if (cur[i].src)
+        dirty[n++] = cur[i].dstrect;
+    }
+
+    /* The beam changes color every frame while it's alive: */
+    if (drawn_laser.alive)
+      laser_line_rect(&drawn_laser, &dirty[n++]);
+    if (laser.alive)
+      laser_line_rect(&laser, &dirty[n++]);
+
+    /* Merge, then cut what overlap is left, so each pixel is painted */
+    /* once, and each area only gets the slots that touch it:          */
+    n = MergeRects(dirty, n);
+    n = laser_split_rects(dirty, n, areas, sizeof(areas) / sizeof(areas[0]));
+
+    for (i = 0; i < n; i++)
+    {
+      SDL_SetClipRect(screen, &areas[i]);
+      laser_draw_scene(cur, &areas[i]);
+    }
+    SDL_SetClipRect(screen, NULL);
+
+    if (n > 0)
+      SDL_UpdateRects(screen, n, areas);
+
+    DEBUGCODE
+    {
+      fprintf(stderr, "laser_update_screen(): repainted %d rects\n", n);
+    }
+  }
+
+  drawn_laser = laser;
+  cur_scene = !cur_scene;
+}
+
+
 /* Draw a line: */
 
+/* Integer (Bresenham) line, LASER_THICK_W x LASER_THICK_H pixels thick. */
+/* Instead of stamping every pixel separately, each run of pixels on the */
+/* same row (or column, for steep lines) is filled as one rectangle,     */
+/* written straight into the screen's pixels:                            */
+
 static void laser_draw_line(int x1, int y1, int x2, int y2, int red, int grn, int blu)
 {
-  int dx, dy, tmp;
-  float m, b;
+  int dx, dy, sx, sy, err, run_start;
   Uint32 pixel;
-  SDL_Rect dest;
- 
+
   pixel = SDL_MapRGB(screen->format, red, grn, blu);
 
-  dx = x2 - x1;
-  dy = y2 - y1;
+  dx = abs(x2 - x1);
+  dy = abs(y2 - y1);
+  sx = (x1 < x2) ? 1 : -1;
+  sy = (y1 < y2) ? 1 : -1;
 
-  laser_putpixel(screen, x1, y1, pixel);
-  
-  if (dx != 0)
-  {
-    m = ((float) dy) / ((float) dx);
-    b = y1 - m * x1;
-
-    if (x2 > x1)
-      dx = 1;
-    else
-      dx = -1;
+  if (SDL_MUSTLOCK(screen) && SDL_LockSurface(screen) < 0)
+    return;
 
+  if (dx >= dy)
+  {
+    /* Mostly horizontal - step along x, one span per row: */
+    err = dx / 2;
+    run_start = x1;
     while (x1 != x2)
     {
-      x1 = x1 + dx;
-      y1 = m * x1 + b;
-      
-      laser_putpixel(screen, x1, y1, pixel);
+      err -= dy;
+      if (err < 0)
+      {
+        laser_fill_rect(screen, (run_start < x1) ? run_start : x1, y1,
+                        abs(x1 - run_start) + LASER_THICK_W, LASER_THICK_H, pixel);
+        y1 += sy;
+        err += dx;
+        x1 += sx;
+        run_start = x1;
+      }
+      else
+        x1 += sx;
     }
+    laser_fill_rect(screen, (run_start < x1) ? run_start : x1, y1,
+                    abs(x1 - run_start) + LASER_THICK_W, LASER_THICK_H, pixel);
   }
   else
   {
-    if (y1 > y2)
+    /* Mostly vertical - step along y, one span per column: */
+    err = dy / 2;
+    run_start = y1;
+    while (y1 != y2)
     {
-      tmp = y1;
-      y1 = y2;
-      y2 = tmp;
+      err -= dx;
+      if (err < 0)
+      {
+        laser_fill_rect(screen, x1, (run_start < y1) ? run_start : y1,
+                        LASER_THICK_W, abs(y1 - run_start) + LASER_THICK_H, pixel);
+        x1 += sx;
+        err += dy;
+        y1 += sy;
+        run_start = y1;
+      }
+      else
+        y1 += sy;
     }
-    
-    dest.x = x1;
-    dest.y = y1;
-    dest.w = 3;
-    dest.h = y2 - y1;
-
-    SDL_FillRect(screen, &dest, pixel);
+    laser_fill_rect(screen, x1, (run_start < y1) ? run_start : y1,
+                    LASER_THICK_W, abs(y1 - run_start) + LASER_THICK_H, pixel);
   }
+
+  if (SDL_MUSTLOCK(screen))
+    SDL_UnlockSurface(screen);
 }
 
 
-/* Draw a single pixel into the surface: */
+/* Fill a rectangle of the (already locked) surface, clipped to its */
+/* clip rect, with one inner loop per pixel size:                   */
 
-static void laser_putpixel(SDL_Surface * surface, int x, int y, Uint32 pixel)
+static void laser_fill_rect(SDL_Surface* surface, int x, int y, int w, int h, Uint32 pixel)
 {
-#ifdef PUTPIXEL_RAW
-  int bpp;
-  Uint8 * p;
-  
-  /* Determine bytes-per-pixel for the surface in question: */
-  
-  bpp = surface->format->BytesPerPixel;
-  
-  
-  /* Set a pointer to the exact location in memory of the pixel
-     in question: */
-  
-  p = (Uint8 *) (surface->pixels +       /* Start at beginning of RAM */
-                 (y * surface->pitch) +  /* Go down Y lines */
-                 (x * bpp));             /* Go in X pixels */
-  
-  
-  /* Assuming the X/Y values are within the bounds of this surface... */
-  
-  if (x >= 0 && y >= 0 && x < surface -> w && y < surface -> h)
-    {
-      /* Set the (correctly-sized) piece of data in the surface's RAM
-         to the pixel value sent in: */
-      
-      if (bpp == 1)
-        *p = pixel;
-      else if (bpp == 2)
-        *(Uint16 *)p = pixel;
-      else if (bpp == 3)
-        {
-          if (SDL_BYTEORDER == SDL_BIG_ENDIAN)
-            {
-              p[0] = (pixel >> 16) & 0xff;
-              p[1] = (pixel >> 8) & 0xff;
-              p[2] = pixel & 0xff;
-            }
-          else
-            {
-              p[0] = pixel & 0xff;
-              p[1] = (pixel >> 8) & 0xff;
-              p[2] = (pixel >> 16) & 0xff;
-            }
-        }
-      else if (bpp == 4)
-        {
-          *(Uint32 *)p = pixel;
-        }
-    }
-#else
-  SDL_Rect dest;
+  SDL_Rect* clip = &surface->clip_rect;
+  Uint8* row;
+  int i, j;
 
-  dest.x = x;
-  dest.y = y;
-  dest.w = 3;
-  dest.h = 4;
+  /* Clip: */
+  if (x < clip->x)
+  {
+    w -= clip->x - x;
+    x = clip->x;
+  }
+  if (y < clip->y)
+  {
+    h -= clip->y - y;
+    y = clip->y;
+  }
+  if (x + w > clip->x + clip->w)
+    w = clip->x + clip->w - x;
+  if (y + h > clip->y + clip->h)
+    h = clip->y + clip->h - y;
+  if (w <= 0 || h <= 0)
+    return;
 
-  SDL_FillRect(surface, &dest, pixel);
-#endif
-}
+  row = (Uint8*)surface->pixels + y * surface->pitch
+      + x * surface->format->BytesPerPixel;
 
+  switch (surface->format->BytesPerPixel)
+  {
+    case 1:
+      for (j = 0; j < h; j++, row += surface->pitch)
+        memset(row, pixel, w);
+      break;
 
-/* Draw image at lower center of screen: */
+    case 2:
+      for (j = 0; j < h; j++, row += surface->pitch)
+      {
+        Uint16* p = (Uint16*)row;
+        for (i = 0; i < w; i++)
+          p[i] = pixel;
+      }
+      break;
 
-static void laser_draw_console_image(int i)
-{
-  SDL_Rect dest;
+    case 3:
+    {
+      Uint8 c0, c1, c2;
+
+      if (SDL_BYTEORDER == SDL_BIG_ENDIAN)
+      {
+        c0 = (pixel >> 16) & 0xff;
+        c1 = (pixel >> 8) & 0xff;
+        c2 = pixel & 0xff;
+      }
+      else
+      {
+        c0 = pixel & 0xff;
+        c1 = (pixel >> 8) & 0xff;
+        c2 = (pixel >> 16) & 0xff;
+      }
 
-  dest.x = (screen->w - images[i]->w) / 2;
-  dest.y = (screen->h - images[i]->h);
-  dest.w = images[i]->w;
-  dest.h = images[i]->h;
+      for (j = 0; j < h; j++, row += surface->pitch)
+      {
+        Uint8* p = row;
+        for (i = 0; i < w; i++, p += 3)
+        {
+          p[0] = c0;
+          p[1] = c1;
+          p[2] = c2;
+        }
+      }
+      break;
+    }
 
-  SDL_BlitSurface(images[i], NULL, screen, &dest);
+    case 4:
+      for (j = 0; j < h; j++, row += surface->pitch)
+      {
+        Uint32* p = (Uint32*)row;
+        for (i = 0; i < w; i++)
+          p[i] = pixel;
+      }
+      break;
+  }
 }
 
 
@@ -1259,99 +1506,68 @@ static void laser_add_score(int inc)
 }
 
 
-/* Stop annoncing thread safely */
-static void stop_tts_announcer()
+/* Posts the bottum most word and it's remaining letters to the  */
+/* announcer thread (see announcer.c).  Called from the game loop, */
+/* whenever the announcer has gone quiet or the player has moved   */
+/* on to another comet or letter.                                  */
+static void queue_announcements(void)
 {
-	tts_announcer_switch = 0;
-}
-
-
-/* This function will announce the bottum most word and 
- * it's remaining letters */
-static int tts_announcer(void *unused)
-{
-	int lowest,lowest_y,i,iter;
-	wchar_t buffer[3000];
+	static int last_lowest = -1, last_pos = -1;
+	wchar_t storage[ANNOUNCE_TEXT_LEN];
+	wstr_builder buffer;
+	int lowest,lowest_y,i,len;
 	int pitch_and_rate;
-	tts_announcer_switch = 1;
-	while(1)
+
+	//Detecting the lowest letter and word on screen		
+	lowest_y = 0;
+	lowest = -1;	
+	for (i = 0; i < MAX_COMETS; i++)
 	{
-		if(tts_announcer_switch == 0)
-			goto end;
-		else if(tts_announcer_switch == 2)
-		{
-			T4K_Tts_say(DEFAULT_VALUE,DEFAULT_VALUE,INTERRUPT,"Score %d!",score);
-			SDL_Delay(20);
-			T4K_Tts_wait();
-			tts_announcer_switch = 1;
-		}
-		else if(tts_announcer_switch == 3)
-		{
-			T4K_Tts_say(DEFAULT_VALUE,DEFAULT_VALUE,INTERRUPT,"%d cities alive!",num_cities_alive);
-			SDL_Delay(20);
-			T4K_Tts_wait();
-			tts_announcer_switch = 1;
-		}		
-		else if(tts_announcer_switch == 4)
+		if (comets[i].alive  &&
+		 comets[i].shootable  &&
+		  comets[i].expl == 0  &&
+		   comets[i].y > lowest_y)
 		{
-			T4K_Tts_say(DEFAULT_VALUE,DEFAULT_VALUE,INTERRUPT,"on wave %d!",wave);
-			SDL_Delay(20);
-			T4K_Tts_wait();
-			tts_announcer_switch = 1;
+			lowest = i;
+			lowest_y = comets[i].y;
 		}
+	}
 
-			
-		
-		//Detecting the lowest letter and word on screen		
-		lowest_y = 0;
-		lowest = -1;	
-		for (i = 0; i < MAX_COMETS; i++)
-		{
-			if (comets[i].alive  &&
-			 comets[i].shootable  &&
-			  comets[i].expl == 0  &&
-			   comets[i].y > lowest_y)
-			{
-				lowest = i;
-				lowest_y = comets[i].y;
-			}
-		}
-		//Skipping if no letter found in screen
-		if (lowest == -1)
-			continue;
-		
-		buffer[0] = L'\0';
-		//Adding the word to buffer
-		wcscpy(buffer,comets[lowest].word);
-		iter = wcslen(comets[lowest].word);
-		
-		//Appending each letters from correct_position if word is not alphabet
-		if (1<wcslen(comets[lowest].word))
+	if (lowest != last_lowest || (lowest != -1 && comets[lowest].pos != last_pos))
+	{
+		//What is still queued is out of date
+		last_lowest = lowest;
+		last_pos = (lowest != -1) ? comets[lowest].pos : -1;
+		ClearAnnouncements();
+	}
+	else if (!AnnouncerIdle())
+		return;
+
+	//Skipping if no letter found in screen
+	if (lowest == -1)
+		return;
+	
+	//Adding the word to buffer
+	wsb_init(&buffer,storage,ANNOUNCE_TEXT_LEN);
+	len = wcslen(comets[lowest].word);
+	wsb_add_n(&buffer,comets[lowest].word,len);
+	
+	//Appending each letters from correct_position if word is not alphabet
+	if (1<len)
+	{
+		for(i=comets[lowest].pos;i<len;i++)
 		{
-			for(i=comets[lowest].pos;i<wcslen(comets[lowest].word);i++)
-			{
-				buffer[iter]=L'.';iter++;
-				buffer[iter]=L' ';iter++;				
-				buffer[iter]=comets[lowest].word[i];iter++;
-			}
+			wsb_add(&buffer,L". ");
+			wsb_add_char(&buffer,comets[lowest].word[i]);
 		}
-		buffer[iter]=L'.';iter++;
-		buffer[iter]=L' ';iter++;		
-		buffer[iter] = L'\0';
-
-		pitch_and_rate = ((lowest_y*100)/(screen->h - images[IMG_CITY_BLUE]->h));
-		if (pitch_and_rate < 30)
-			pitch_and_rate = 30;
-		if (pitch_and_rate > 60)
-			pitch_and_rate = 60;	
-		T4K_Tts_say(pitch_and_rate,pitch_and_rate,INTERRUPT,"%S",buffer);
-		
-		//Wait to finish saying the previus word
-		SDL_WaitThread(tts_thread,NULL);
-		SDL_Delay(100);
-		fprintf(stderr,"\nPos = %d",braille_letter_pos);
-			
 	}
-	end:
-	return 1;
+	wsb_add(&buffer,L". ");
+
+	pitch_and_rate = ((lowest_y*100)/(screen->h - images[IMG_CITY_BLUE]->h));
+	if (pitch_and_rate < 30)
+		pitch_and_rate = 30;
+	if (pitch_and_rate > 60)
+		pitch_and_rate = 60;	
+	AnnounceText(wsb_str(&buffer),pitch_and_rate);
+	DEBUGCODE {fprintf(stderr,"\nPos = %d",braille_letter_pos);}
 }
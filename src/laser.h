@@ -60,6 +60,13 @@ typedef struct laser_type {
   int x2, y2;
 } laser_type;
 
+/* One image drawn as part of a frame - see laser_build_scene(): */
+typedef struct scene_blit {
+  SDL_Surface* src;   /* NULL if nothing is drawn in this slot */
+  SDL_Rect srcrect;
+  SDL_Rect dstrect;
+} scene_blit;
+
 enum {
   MUS_GAME,
   MUS_GAME2,
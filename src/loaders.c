@@ -30,13 +30,68 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "globals.h"
 #include "funcs.h"
 #include "SDL_extras.h"
+#include "braille.h"
 #include "mysetenv.h"
 
+#ifndef WIN32
+#include <utime.h>
+#endif
+
 static SDL_Surface* win_bkgd = NULL;
 static SDL_Surface* fullscr_bkgd = NULL;
 
+/* Only the background for the current screen mode is loaded up front - */
+/* the other one is made by CurrentBkgd() if and when it is needed:     */
+static char bkgd_file[FNLEN] = "";
+static int win_bkgd_tried = 0;
+static int fullscr_bkgd_tried = 0;
+
+/* Scaled backgrounds are cached on disk as raw pixel dumps in the     */
+/* display format, under the user settings path, so loading the same   */
+/* background again skips decoding and zoom(). The cache is trimmed    */
+/* (least recently used first) to stay under BKGD_CACHE_MAX_BYTES:     */
+#define BKGD_CACHE_DIR "bkgd_cache"
+#define BKGD_CACHE_MAX_BYTES (128 * 1024 * 1024)
+#define BKGD_CACHE_MAGIC "TTBKGD1"
+
+typedef struct bkgd_cache_header {
+  char magic[8];
+  Uint32 w, h, bpp;
+  Uint32 r_mask, g_mask, b_mask, a_mask;
+  Uint32 src_mtime, src_size;
+  char src_path[FNLEN];
+} bkgd_cache_header;
+
+/* A background being loaded ahead of time by PrefetchBkgd(). The main  */
+/* thread fills in everything the worker needs before starting it, so   */
+/* the worker never touches the screen or the video subsystem - it only */
+/* decodes and scales into a plain 32 bpp surface, which the main       */
+/* thread converts to the display format in take_prefetched_bkgd().     */
+/* The thread only writes 'prefetch_surf' and 'prefetch_from_cache',    */
+/* which the main thread only looks at after waiting for it to finish:  */
+static SDL_Thread* prefetch_thread = NULL;
+static char prefetch_file[FNLEN] = "";
+static char prefetch_src[FNLEN] = "";
+static struct stat prefetch_st;
+static bkgd_cache_header prefetch_hdr;
+static int prefetch_use_cache = 0;
+static int prefetch_w = 0, prefetch_h = 0;
+static SDL_Surface* prefetch_surf = NULL;
+static int prefetch_from_cache = 0;
+
 /* Local function prototypes: */
 static int max(int n1, int n2);
+static int bkgd_source_file(const char* datafile, char* fn, struct stat* st);
+static void bkgd_cache_header_init(bkgd_cache_header* hdr, const char* src_fn,
+                                   struct stat* st, int w, int h);
+static void bkgd_cache_filename(bkgd_cache_header* hdr, char* fn);
+static SDL_Surface* bkgd_cache_load(const char* src_fn, struct stat* st, int w, int h);
+static SDL_Surface* bkgd_cache_read(bkgd_cache_header* want);
+static void bkgd_cache_store(const char* src_fn, struct stat* st, SDL_Surface* s);
+static void bkgd_cache_trim(void);
+static SDL_Surface* load_scaled_bkgd(const char* datafile, int w, int h, int* scaled);
+static int prefetch_worker(void* unused);
+static SDL_Surface* take_prefetched_bkgd(const char* datafile, int w, int h);
 //static SDL_Surface* flip(SDL_Surface *in, int x, int y);
 
 /* Returns 1 if valid file, 2 if valid dir, 0 if neither: */
@@ -383,57 +438,520 @@ SDL_Surface* LoadImage(const char* datafile, int mode)
 
 
 
+/* Find the file LoadImage() would load for 'datafile' (theme path     */
+/* first, unless using English, then default path), and stat it.        */
+/* Returns 1 if found, 0 if not:                                        */
+static int bkgd_source_file(const char* datafile, char* fn, struct stat* st)
+{
+  if (!settings.use_english)
+  {
+    snprintf(fn, FNLEN, "%s/images/%s", settings.theme_data_path, datafile);
+    if (stat(fn, st) == 0)
+      return 1;
+  }
+
+  snprintf(fn, FNLEN, "%s/images/%s", settings.default_data_path, datafile);
+  return (stat(fn, st) == 0);
+}
+
+
+/* Fill in the header that a cached copy of 'src_fn' scaled to 'w' x 'h' */
+/* for the current display format would have:                            */
+static void bkgd_cache_header_init(bkgd_cache_header* hdr, const char* src_fn,
+                                   struct stat* st, int w, int h)
+{
+  memset(hdr, 0, sizeof(bkgd_cache_header));
+  strcpy(hdr->magic, BKGD_CACHE_MAGIC);
+  hdr->w = w;
+  hdr->h = h;
+  hdr->bpp = screen->format->BytesPerPixel;
+  hdr->r_mask = screen->format->Rmask;
+  hdr->g_mask = screen->format->Gmask;
+  hdr->b_mask = screen->format->Bmask;
+  hdr->a_mask = screen->format->Amask;
+  hdr->src_mtime = st->st_mtime;
+  hdr->src_size = st->st_size;
+  strncpy(hdr->src_path, src_fn, FNLEN - 1);
+}
+
+
+/* Cache file name is a hash of everything in the header: */
+static void bkgd_cache_filename(bkgd_cache_header* hdr, char* fn)
+{
+  const unsigned char* p = (const unsigned char*)hdr;
+  Uint32 hash = 2166136261u;   /* FNV-1a */
+  int i;
+
+  for (i = 0; i < sizeof(bkgd_cache_header); i++)
+    hash = (hash ^ p[i]) * 16777619u;
+
+  snprintf(fn, FNLEN, "%s/%s/%08x.bkgd",
+           settings.user_settings_path, BKGD_CACHE_DIR, (unsigned int)hash);
+}
+
+
+/* Returns the cached copy of 'src_fn' scaled to 'w' x 'h', or NULL */
+/* if there isn't a valid one:                                      */
+static SDL_Surface* bkgd_cache_load(const char* src_fn, struct stat* st, int w, int h)
+{
+  bkgd_cache_header want;
+
+  if (!screen || !settings.user_settings_path[0])
+    return NULL;
+
+  bkgd_cache_header_init(&want, src_fn, st, w, h);
+  return bkgd_cache_read(&want);
+}
+
+
+/* Reads the cache file matching header 'want', or returns NULL. This */
+/* doesn't look at the screen, so the prefetch thread can use it:     */
+static SDL_Surface* bkgd_cache_read(bkgd_cache_header* want)
+{
+  bkgd_cache_header got;
+  char fn[FNLEN];
+  FILE* fp;
+  SDL_Surface* s;
+  int w = want->w, h = want->h;
+  int y, ok = 1;
+
+  bkgd_cache_filename(want, fn);
+
+  fp = fopen(fn, "rb");
+  if (!fp)
+    return NULL;
+
+  /* Make sure it really is what we want, not just a hash collision: */
+  if (fread(&got, sizeof(got), 1, fp) != 1
+   || memcmp(want, &got, sizeof(got)) != 0)
+  {
+    fclose(fp);
+    return NULL;
+  }
+
+  s = SDL_CreateRGBSurface(SDL_SWSURFACE, w, h, want->bpp * 8,
+                           want->r_mask, want->g_mask, want->b_mask, want->a_mask);
+  if (!s)
+  {
+    fclose(fp);
+    return NULL;
+  }
+
+  SDL_LockSurface(s);
+  for (y = 0; y < h && ok; y++)
+    ok = (fread((Uint8*)s->pixels + y * s->pitch, w * want->bpp, 1, fp) == 1);
+  SDL_UnlockSurface(s);
+  fclose(fp);
+
+  if (!ok)
+  {
+    SDL_FreeSurface(s);
+    return NULL;
+  }
+
+  /* Mark as recently used, for bkgd_cache_trim(): */
+#ifndef WIN32
+  utime(fn, NULL);
+#endif
+
+  DEBUGCODE { fprintf(stderr, "Background cache hit: %s (%dx%d)\n", want->src_path, w, h); }
+
+  return s;
+}
+
+
+/* Saves 's' (a scaled copy of 'src_fn') in the cache: */
+static void bkgd_cache_store(const char* src_fn, struct stat* st, SDL_Surface* s)
+{
+  bkgd_cache_header hdr;
+  char dir[FNLEN];
+  char fn[FNLEN];
+  char tmp_fn[FNLEN + 32];
+  FILE* fp;
+  int y, ok;
+
+  if (!s || !screen || !settings.user_settings_path[0]
+   || s->format->BytesPerPixel != screen->format->BytesPerPixel)
+    return;
+
+  snprintf(dir, FNLEN, "%s/%s", settings.user_settings_path, BKGD_CACHE_DIR);
+  if (CheckFile(dir) != 2)
+  {
+#ifdef WIN32
+    _mkdir(dir);
+#else
+    mkdir(dir, 0755);
+#endif
+  }
+
+  bkgd_cache_header_init(&hdr, src_fn, st, s->w, s->h);
+  bkgd_cache_filename(&hdr, fn);
+
+  /* Write to a temporary name first, so another copy of the program */
+  /* (or a background prefetch) can never see a half-written file:   */
+  snprintf(tmp_fn, sizeof(tmp_fn), "%s.%lu.tmp", fn, (unsigned long)SDL_ThreadID());
+  fp = fopen(tmp_fn, "wb");
+  if (!fp)
+    return;
+
+  ok = (fwrite(&hdr, sizeof(hdr), 1, fp) == 1);
+  SDL_LockSurface(s);
+  for (y = 0; y < s->h && ok; y++)
+    ok = (fwrite((Uint8*)s->pixels + y * s->pitch, s->w * hdr.bpp, 1, fp) == 1);
+  SDL_UnlockSurface(s);
+  ok = (fclose(fp) == 0) && ok;
+
+  if (!ok || rename(tmp_fn, fn) != 0)
+  {
+    remove(tmp_fn);
+    return;
+  }
+
+  bkgd_cache_trim();
+}
+
+
+typedef struct bkgd_cache_entry {
+  char name[FNLEN];
+  time_t mtime;
+  off_t size;
+} bkgd_cache_entry;
+
+static int compare_cache_entry_age(const void* a, const void* b)
+{
+  time_t ta = ((const bkgd_cache_entry*)a)->mtime;
+  time_t tb = ((const bkgd_cache_entry*)b)->mtime;
+  return (ta < tb) ? -1 : (ta > tb);
+}
+
+
+/* Deletes the least recently used cache files until the cache fits */
+/* in BKGD_CACHE_MAX_BYTES:                                         */
+static void bkgd_cache_trim(void)
+{
+  char dir[FNLEN];
+  char fn[FNLEN];
+  DIR* dp;
+  struct dirent* de;
+  struct stat st;
+  bkgd_cache_entry* entries = NULL;
+  int num = 0, max_entries = 0, i;
+  long long total = 0;
+
+  snprintf(dir, FNLEN, "%s/%s", settings.user_settings_path, BKGD_CACHE_DIR);
+  dp = opendir(dir);
+  if (!dp)
+    return;
+
+  while ((de = readdir(dp)))
+  {
+    int len = strlen(de->d_name);
+    if (len < 5 || strcmp(de->d_name + len - 5, ".bkgd") != 0)
+      continue;
+
+    snprintf(fn, FNLEN, "%s/%s", dir, de->d_name);
+    if (stat(fn, &st) != 0)
+      continue;
+
+    if (num == max_entries)
+    {
+      bkgd_cache_entry* p;
+      max_entries = max_entries ? max_entries * 2 : 16;
+      p = realloc(entries, max_entries * sizeof(bkgd_cache_entry));
+      if (!p)
+        break;
+      entries = p;
+    }
+
+    strncpy(entries[num].name, fn, FNLEN - 1);
+    entries[num].name[FNLEN - 1] = '\0';
+    entries[num].mtime = st.st_mtime;
+    entries[num].size = st.st_size;
+    total += st.st_size;
+    num++;
+  }
+  closedir(dp);
+
+  if (total > BKGD_CACHE_MAX_BYTES)
+  {
+    qsort(entries, num, sizeof(bkgd_cache_entry), compare_cache_entry_age);
+    for (i = 0; i < num && total > BKGD_CACHE_MAX_BYTES; i++)
+    {
+      DEBUGCODE { fprintf(stderr, "Evicting cached background %s\n", entries[i].name); }
+      if (remove(entries[i].name) == 0)
+        total -= entries[i].size;
+    }
+  }
+
+  free(entries);
+}
+
+
+/* Returns background 'datafile' scaled to 'w' x 'h', from the cache if */
+/* possible. Increments '*scaled' if zoom() was needed:                 */
+static SDL_Surface* load_scaled_bkgd(const char* datafile, int w, int h, int* scaled)
+{
+  char src_fn[FNLEN];
+  struct stat src_st;
+  int have_src;
+  SDL_Surface* orig;
+  SDL_Surface* s;
+
+  have_src = bkgd_source_file(datafile, src_fn, &src_st);
+  if (have_src)
+  {
+    s = bkgd_cache_load(src_fn, &src_st, w, h);
+    if (s)
+      return s;
+  }
+
+  orig = LoadImage(datafile, IMG_REGULAR);
+  if (!orig)
+  {
+    fprintf(stderr, "load_scaled_bkgd() - could not load %s\n", datafile);
+    return NULL;
+  }
+
+  DEBUGCODE
+  {
+     printf("Scaling %dx%d to: %dx%d\n", orig->w, orig->h, w, h);
+  }
+
+  if (orig->w == w && orig->h == h)
+    s = orig;
+  else
+  {
+    s = zoom(orig, w, h);
+    SDL_FreeSurface(orig);
+    if (scaled)
+      ++*scaled;
+  }
+
+  if (have_src)
+    bkgd_cache_store(src_fn, &src_st, s);
+
+  return s;
+}
+
+
 /**********************
-LoadBothBkgds() : loads two scaled images: one for the user's native 
-resolution and one for 640x480 fullscreen. 
+LoadBothBkgds() : sets the background to be used, scaled for the 
+user's native resolution and for fullscreen. Only the one for the 
+current screen mode is actually loaded here - CurrentBkgd() loads 
+the other one if the mode is switched.
 Returns: the number of images that were scaled
 **********************/
 int LoadBothBkgds(const char* datafile)
 {
   int ret = 0;
-  SDL_Surface* orig = NULL;
-  
+
   //Avoid memory leak in case something else already loaded:
   FreeBothBkgds();
 
   LOG("Entering LoadBothBkgds()\n");
 
-  orig = LoadImage(datafile, IMG_REGULAR);
+  if (!datafile)
+    return 0;
+
+  strncpy(bkgd_file, datafile, FNLEN - 1);
+  bkgd_file[FNLEN - 1] = '\0';
+
+  if (screen && (screen->flags & SDL_FULLSCREEN))
+  {
+    fullscr_bkgd = take_prefetched_bkgd(bkgd_file, fs_res_x, fs_res_y);
+    if (!fullscr_bkgd)
+      fullscr_bkgd = load_scaled_bkgd(bkgd_file, fs_res_x, fs_res_y, &ret);
+    fullscr_bkgd_tried = 1;
+  }
+  else
+  {
+    win_bkgd = take_prefetched_bkgd(bkgd_file, RES_X, RES_Y);
+    if (!win_bkgd)
+      win_bkgd = load_scaled_bkgd(bkgd_file, RES_X, RES_Y, &ret);
+    win_bkgd_tried = 1;
+  }
 
   DEBUGCODE
   {
-     printf("Scaling %dx%d to: %dx%d, %dx%d\n", 
-           orig->w, orig->h, RES_X, RES_Y, fs_res_x, fs_res_y);
+    printf("%d images scaled\nLeaving LoadBothBkgds()\n", ret);
   }
+  return ret;
+}
+
+
+/**********************
+PrefetchBkgd() : starts loading 'datafile' (scaled for the current 
+screen mode) on a separate thread, so that a later LoadBothBkgds() 
+of the same file just has to pick it up. Any earlier prefetch is 
+discarded.
+Returns: 1 if the thread was started, 0 if not
+**********************/
+int PrefetchBkgd(const char* datafile)
+{
+#ifdef HAVE_RSVG
+  char svgfn[FNLEN];
+  char* dotpos;
+  struct stat svg_st;
+#endif
+
+  CancelBkgdPrefetch();
+
+  if (!datafile || !screen)
+    return 0;
 
-  if (orig->w == RES_X && orig->h == RES_Y)
+  if (!bkgd_source_file(datafile, prefetch_src, &prefetch_st))
+    return 0;
+
+#ifdef HAVE_RSVG
+  /* LoadImage() would use an SVG version if there is one, and librsvg */
+  /* is not ours to call off the main thread, so leave that to it:     */
+  strcpy(svgfn, prefetch_src);
+  dotpos = strrchr(svgfn, '.');
+  if (dotpos && dotpos - svgfn + 5 <= FNLEN)
+  {
+    strcpy(dotpos, ".svg");
+    if (stat(svgfn, &svg_st) == 0)
+      return 0;
+  }
+#endif
+
+  strncpy(prefetch_file, datafile, FNLEN - 1);
+  prefetch_file[FNLEN - 1] = '\0';
+
+  if (screen->flags & SDL_FULLSCREEN)
   {
-    win_bkgd = orig;
+    prefetch_w = fs_res_x;
+    prefetch_h = fs_res_y;
   }
   else
   {
-    win_bkgd = zoom(orig, RES_X, RES_Y);
-    ++ret;
+    prefetch_w = RES_X;
+    prefetch_h = RES_Y;
   }
-  
-  if (orig->w == fs_res_x && orig->h == fs_res_y)
+
+  /* The worker can't look at the screen, so work out its cache entry here: */
+  prefetch_use_cache = (settings.user_settings_path[0] != '\0');
+  if (prefetch_use_cache)
+    bkgd_cache_header_init(&prefetch_hdr, prefetch_src, &prefetch_st,
+                           prefetch_w, prefetch_h);
+
+  prefetch_thread = SDL_CreateThread(prefetch_worker, NULL);
+  if (!prefetch_thread)
+  {
+    fprintf(stderr, "PrefetchBkgd() - could not create thread: %s\n", SDL_GetError());
+    prefetch_file[0] = '\0';
+    return 0;
+  }
+
+  DEBUGCODE { fprintf(stderr, "Prefetching background %s\n", prefetch_file); }
+
+  return 1;
+}
+
+
+/* Waits for any prefetch in progress and throws away its result: */
+void CancelBkgdPrefetch(void)
+{
+  if (prefetch_thread)
+  {
+    SDL_WaitThread(prefetch_thread, NULL);
+    prefetch_thread = NULL;
+  }
+
+  if (prefetch_surf)
+    SDL_FreeSurface(prefetch_surf);
+  prefetch_surf = NULL;
+  prefetch_from_cache = 0;
+  prefetch_file[0] = '\0';
+}
+
+
+/* Runs on its own thread, so no SDL video calls (SDL_DisplayFormat() */
+/* etc.) and no zoom() thread pool - the main thread may be using it: */
+static int prefetch_worker(void* unused)
+{
+  SDL_Surface* orig;
+  SDL_Surface* fmt;
+  SDL_Surface* rgb = NULL;
+
+  if (prefetch_use_cache)
+  {
+    prefetch_surf = bkgd_cache_read(&prefetch_hdr);
+    if (prefetch_surf)
+    {
+      prefetch_from_cache = 1;
+      return 0;
+    }
+  }
+
+  orig = IMG_Load(prefetch_src);
+  if (!orig)
   {
-    fullscr_bkgd = orig;
+    fprintf(stderr, "prefetch_worker() - could not load %s\n", prefetch_src);
+    return 0;
   }
+
+  /* Plain 32 bpp RGB, which zoom() handles with its fast path: */
+  fmt = SDL_CreateRGBSurface(SDL_SWSURFACE, 1, 1, 32,
+                             0x00FF0000, 0x0000FF00, 0x000000FF, 0);
+  if (fmt)
+  {
+    rgb = SDL_ConvertSurface(orig, fmt->format, SDL_SWSURFACE);
+    SDL_FreeSurface(fmt);
+  }
+  SDL_FreeSurface(orig);
+  if (!rgb)
+    return 0;
+
+  if (rgb->w == prefetch_w && rgb->h == prefetch_h)
+    prefetch_surf = rgb;
   else
   {
-    fullscr_bkgd = zoom(orig, fs_res_x, fs_res_y);
-    ++ret;
+    prefetch_surf = zoom_serial(rgb, prefetch_w, prefetch_h);
+    SDL_FreeSurface(rgb);
   }
-  
-  if (ret == 2) //orig won't be used at all
-    SDL_FreeSurface(orig);
-    
-  DEBUGCODE
+  return 0;
+}
+
+
+/* If 'datafile' has been prefetched at 'w' x 'h', hand it over in the */
+/* current display format (waiting for it if need be), and put it in   */
+/* the disk cache if it wasn't from there.                             */
+/* Otherwise, or if there was no prefetch, returns NULL:               */
+static SDL_Surface* take_prefetched_bkgd(const char* datafile, int w, int h)
+{
+  SDL_Surface* s = NULL;
+
+  if (!prefetch_thread && !prefetch_surf)
+    return NULL;
+
+  if (prefetch_thread)
   {
-    printf("%d images scaled\nLeaving LoadBothBkgds()\n", ret);
+    SDL_WaitThread(prefetch_thread, NULL);
+    prefetch_thread = NULL;
   }
-  return ret;
+
+  if (prefetch_surf
+   && strcmp(prefetch_file, datafile) == 0
+   && prefetch_w == w && prefetch_h == h
+   && screen)
+  {
+    if (!prefetch_from_cache)
+    {
+      s = SDL_DisplayFormat(prefetch_surf);
+      if (s && prefetch_use_cache)
+        bkgd_cache_store(prefetch_src, &prefetch_st, s);
+    }
+    else if (prefetch_surf->format->BytesPerPixel == screen->format->BytesPerPixel)
+    {
+      s = prefetch_surf;
+      prefetch_surf = NULL;
+    }
+    DEBUGCODE { if (s) fprintf(stderr, "Using prefetched background %s\n", datafile); }
+  }
+
+  CancelBkgdPrefetch();
+  return s;
 }
 
 
@@ -441,10 +959,49 @@ SDL_Surface* CurrentBkgd(void)
 {
   if (!screen)
     return NULL;
+
   if (screen->flags & SDL_FULLSCREEN)
+  {
+    if (!fullscr_bkgd && !fullscr_bkgd_tried && bkgd_file[0])
+    {
+      fullscr_bkgd_tried = 1;
+      fullscr_bkgd = load_scaled_bkgd(bkgd_file, fs_res_x, fs_res_y, NULL);
+    }
     return fullscr_bkgd;
+  }
   else
+  {
+    if (!win_bkgd && !win_bkgd_tried && bkgd_file[0])
+    {
+      win_bkgd_tried = 1;
+      win_bkgd = load_scaled_bkgd(bkgd_file, RES_X, RES_Y, NULL);
+    }
     return win_bkgd;
+  }
+}
+
+
+/* Free the background for the screen mode we are not in - CurrentBkgd() */
+/* will make it again if needed:                                         */
+void ReleaseInactiveBkgd(void)
+{
+  if (!screen)
+    return;
+
+  if (screen->flags & SDL_FULLSCREEN)
+  {
+    if (win_bkgd)
+      SDL_FreeSurface(win_bkgd);
+    win_bkgd = NULL;
+    win_bkgd_tried = 0;
+  }
+  else
+  {
+    if (fullscr_bkgd)
+      SDL_FreeSurface(fullscr_bkgd);
+    fullscr_bkgd = NULL;
+    fullscr_bkgd_tried = 0;
+  }
 }
 
 void FreeBothBkgds(void)
@@ -456,20 +1013,40 @@ void FreeBothBkgds(void)
   if (fullscr_bkgd)
     SDL_FreeSurface(fullscr_bkgd);
   fullscr_bkgd = NULL;
+
+  win_bkgd_tried = fullscr_bkgd_tried = 0;
+  bkgd_file[0] = '\0';
 }
 
 
+/* Makes a mirrored copy of 'in'. Only the default image and the first */
+/* frame are flipped here - the rest are made by SpriteFrame() when     */
+/* first drawn, so 'in' must not be freed before the returned sprite:   */
 sprite* FlipSprite(sprite* in, int X, int Y ) {
 	sprite* out;
+	int x;
+
+	if (!in)
+		return NULL;
 
 	out = malloc(sizeof(sprite));
+	if (!out)
+		return NULL;
+
 	if (in->default_img != NULL)
 		out->default_img = Flip( in->default_img, X, Y );
 	else
 		out->default_img = NULL;
-	for ( out->num_frames=0; out->num_frames<in->num_frames; out->num_frames++ )
-		out->frame[out->num_frames] = Flip( in->frame[out->num_frames], X, Y );
+	for (x = 0; x < MAX_SPRITE_FRAMES; x++)
+		out->frame[x] = NULL;
+	out->num_frames = in->num_frames;
 	out->cur = 0;
+	out->flip_src = in;
+	out->flip_x = X;
+	out->flip_y = Y;
+
+	/* Callers look at frame[0] for the sprite's size: */
+	SpriteFrame(out, 0);
 	return out;
 }
 
@@ -481,6 +1058,8 @@ sprite* LoadSprite(const char* name, int MODE ) {
 	/* JA --- HACK check out what has changed with new code */
 
 	new_sprite = malloc(sizeof(sprite));
+	new_sprite->flip_src = NULL;
+	new_sprite->flip_x = new_sprite->flip_y = 0;
 
 	sprintf(fn, "%sd.png", name);
 	new_sprite->default_img = LoadImage( fn, MODE|IMG_NOT_REQUIRED );
@@ -33,13 +33,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "playgame.h"
 #include "snow.h"
 #include "SDL_extras.h"
+#include "braille.h"
+#include "convert_utf.h"
+#include "announcer.h"
 #include "input_methods.h"
 
 
 /* Should these be constants? */
 static int tux_max_width = 0;                // the max width of the images of tux
 static int number_max_w = 0;                 // the max width of a number image
-static int tts_announcer_switch = 1;
 static int braille_letter_pos=0;
 
 //static SDL_Surface* background = NULL;
@@ -74,9 +76,13 @@ static void EraseNumbers(int num, int x, int y, int places);
 
 static float float_restrict(float a, float x, float b);
 static void FreeGame(void);
+static void free_fish_strips(struct fishypoo* f);
+static SDL_Surface* fish_body(int len);
+static void free_fish_bodies(void);
 
-static void stop_tts_announcer();
-static int tts_announcer(void *struct_address);
+static void queue_announcements(int fishies);
+static int fish_pitch(int which);
+static void add_spelled_word(wstr_builder* sb, const wchar_t* word, int from);
 
 static void set_braille_letter_pos(int fishies);
 
@@ -89,6 +95,7 @@ static int LoadTuxAnims(void);
 static void MoveFishies(int* fishies, int* splats, int* lifes, int* frame);
 static void MoveTux(int frame, int fishies);
 static void next_tux_frame(void);
+static SDL_Surface* fish_strip(struct fishypoo* f, int red_letters);
 static void ResetObjects(void);
 static void SpawnFishies(int diflevel, int* fishies, int* frame);
 static void UpdateTux(wchar_t letter_pressed, int fishies, int frame);
@@ -109,6 +116,7 @@ int playing_level,fish_left,curlives;
 int PlayCascade(int diflevel)
 {
   char filename[FNLEN];
+  int next_bkgd = -1;  // background for next level, already being loaded
   int still_playing = 1;
   playing_level = 1;
   int setup_new_level = 1;
@@ -144,21 +152,6 @@ int PlayCascade(int diflevel)
   int braille_iter;
 
 
-
-  //Structure which contain the address of above struct 
-  //Why ? : Only one argument can be passed through thread    
-  //Structure which contain the address of variables 
-  struct tts_announcer_cascade_data_struct struct_with_data_address;
-  
-  //Giving address of variables
-  struct_with_data_address.address_of_fishies = &fishies;
-
-
-  //Call announcer function in thread which annonces the word to type 
-  if(settings.tts)
-	tts_announcer_thread = SDL_CreateThread(tts_announcer, &struct_with_data_address);
-  
-
   DEBUGCODE
   {
     fprintf(stderr, "->Entering PlayCascade(): level=%i\n", diflevel);
@@ -193,6 +186,10 @@ int PlayCascade(int diflevel)
     return 0;
   }
 
+  //Start the thread which annonces the words to type
+  if(settings.tts)
+	StartAnnouncer();
+
 
   /*  --------- Begin outer game loop (cycles once per level): ------------- */
 
@@ -247,7 +244,10 @@ int PlayCascade(int diflevel)
         sprintf(filename, "pract.png");
       else
       {	
-        sprintf(filename, "kcas%d.jpg", rand() % 12);
+        if (next_bkgd < 0)
+          next_bkgd = rand() % 12;
+        sprintf(filename, "kcas%d.jpg", next_bkgd);
+        next_bkgd = -1;
       }
       /* ---  Special Hidden Code  --- */
 
@@ -261,6 +261,15 @@ int PlayCascade(int diflevel)
         LoadBothBkgds(filename);
 //			SNOW_setBkg( background );
 
+      /* Choose the next level's background now, and load it while */
+      /* this level is being played:                               */
+      if (diflevel != INF_PRACT)
+      {
+        next_bkgd = rand() % 12;
+        sprintf(filename, "kcas%d.jpg", next_bkgd);
+        PrefetchBkgd(filename);
+      }
+
       DrawBackground();
 
       ResetObjects();
@@ -349,17 +358,18 @@ int PlayCascade(int diflevel)
 
 			   /* Fish left */
 			   case SDLK_F1:
-				tts_announcer_switch = 2;
+				ClearAnnouncements();
+				AnnounceCount("fish_left %d!",fish_left);
 				break;
 			
 			   /* lives remaining */
 			   case SDLK_F2:
-				tts_announcer_switch = 3;
+				ClearAnnouncements();
+				AnnounceCount("%d lives remaining!",curlives);
 				break;				
 
               case SDLK_ESCAPE:
-				if(settings.tts)
-					stop_tts_announcer();
+				ClearAnnouncements();
 				T4K_Tts_say(DEFAULT_VALUE,DEFAULT_VALUE,INTERRUPT,gettext("Game Paused."));
                 
                 /* Pause() returns 1 if quitting, */
@@ -373,9 +383,6 @@ int PlayCascade(int diflevel)
                 else  /* Returning to game */
                 {
 				  T4K_Tts_say(DEFAULT_VALUE,DEFAULT_VALUE,INTERRUPT,gettext("Pause Released!"));
-				  //Call announcer function in thread which annonces the word to type
-				  if(settings.tts)
-						tts_announcer_thread = SDL_CreateThread(tts_announcer, &struct_with_data_address);
 				  DrawBackground();
 				}
                 break;
@@ -435,21 +442,18 @@ int PlayCascade(int diflevel)
 				/* ----- SDL_KEYUP is Only for Braille Mode -------------*/
 				if(settings.braille)
 				{
-					arrange_in_order(pressed_letters);
-				    if (wcscmp(pressed_letters,L"") != 0)
+					struct braille_dict* chord_entry;
+					/* Every character sharing this chord is tried: */
+					for (chord_entry = braille_chord_lookup(braille_chord_from_keys(pressed_letters));
+					     chord_entry;
+					     chord_entry = braille_chord_next(chord_entry))
 				    {
-					   for(i=0;i<100;i++)
-					   {
-						   if (wcscmp(pressed_letters,braille_key_value_map[i].key) == 0)
-						   {
-							   if (braille_letter_pos == 0)
-									UpdateTux(toupper(braille_key_value_map[i].value_begin[0]), fishies, frame);
-							   else if (braille_letter_pos == 1)
-									UpdateTux(toupper(braille_key_value_map[i].value_middle[0]), fishies, frame);
-							   else
-									UpdateTux(toupper(braille_key_value_map[i].value_end[0]), fishies, frame);																					   
-						   }
-					   }	   
+					   if (braille_letter_pos == 0)
+							UpdateTux(toupper(chord_entry->value_begin[0]), fishies, frame);
+					   else if (braille_letter_pos == 1)
+							UpdateTux(toupper(chord_entry->value_middle[0]), fishies, frame);
+					   else
+							UpdateTux(toupper(chord_entry->value_end[0]), fishies, frame);
 				   }
 				   /* --- Clearing the pressed_letters  ---- */	
 				   braille_iter = 0;
@@ -475,6 +479,8 @@ int PlayCascade(int diflevel)
       DrawSprite(tux_object.spr[tux_object.state][tux_object.facing], tux_object.x, tux_object.y);
       MoveFishies(&fishies, &splats, &curlives, &frame);
       CheckFishies(&fishies, &splats);
+      if (settings.tts)
+        queue_announcements(fishies);
 //      SNOW_update();
 
       /* --- update top score/info bar --- */
@@ -545,8 +551,7 @@ int PlayCascade(int diflevel)
       if (won_level) 
       {
 		 
-		if(settings.tts)
-			stop_tts_announcer();
+		ClearAnnouncements();
   
         if (settings.sys_sound) 
           Mix_PlayChannel(WIN_WAV, sound[WIN_WAV], 0);
@@ -586,8 +591,7 @@ int PlayCascade(int diflevel)
         xamp = 0;
         yamp = 0;
 
-        if(settings.tts)
-			stop_tts_announcer();        
+        ClearAnnouncements();
 
         if (settings.sys_sound)
           Mix_PlayChannel(LOSE_WAV, sound[LOSE_WAV], 0);
@@ -644,11 +648,7 @@ int PlayCascade(int diflevel)
           
       }  /* End of animation for end of game */
      if (still_playing)
-     {
-		fishies = 0; //Otherwise thread will announce old words and cause segfault
-		if(settings.tts)
-			tts_announcer_thread = SDL_CreateThread(tts_announcer, &struct_with_data_address);
-	 }
+		fishies = 0; //Don't carry the old fish into the next level
 	
     }  /* End of post-level wrap-up  */
   
@@ -658,8 +658,7 @@ int PlayCascade(int diflevel)
 
   //N.x.L
   fprintf(stderr,"Exiting game");
-  if(settings.tts)
-	stop_tts_announcer();
+  StopAnnouncer();
 
 
 
@@ -737,6 +736,7 @@ static void ResetObjects(void)
 
   for (i = 0; i < MAX_FISHIES_HARD + 1; i++)
   {
+    free_fish_strips(&fish_object[i]);
     fish_object[i] = null_fishy;
     splat_object[i] = null_splat;
   }
@@ -826,6 +826,9 @@ static void LoadOthers(void)
 	null_fishy.x = 0;
 	null_fishy.y = 0;
 	null_fishy.dy = 0;
+	null_fishy.strips = NULL;
+	null_fishy.strips_red = -1;
+	null_fishy.drawn = NULL;
 
 	null_splat.x = 0;
 	null_splat.y = 0;
@@ -994,6 +997,10 @@ static void FreeGame(void)
 {
   int i;
 
+  for (i = 0; i < MAX_FISHIES_HARD + 1; i++)
+    free_fish_strips(&fish_object[i]);
+  free_fish_bodies();
+
   FreeLetters();
 
   LOG( "FreeGame():\n-Freeing Tux Animations\n" );
@@ -1019,6 +1026,7 @@ static void FreeGame(void)
 
   LOG( "-Freeing other game graphics\n" );
 
+  CancelBkgdPrefetch();
   FreeBothBkgds();
 
   if (curlev)
@@ -1158,12 +1166,7 @@ static void SpawnFishies(int diflevel, int* fishies, int* frame)
   /* See how long of a word will fit the length of our screen: */
   max_length = screen->w / fish_sprite->frame[0]->w;
 
-  do
-  {
-    new_word = GetWord();
-    if (!new_word) break;
-  }
-  while(wcslen(new_word) > max_length);
+  new_word = GetWordMaxLen(max_length);
 
   /* See if we get a valid word before we move on: */
   if (!new_word)
@@ -1174,6 +1177,7 @@ static void SpawnFishies(int diflevel, int* fishies, int* frame)
 
 
   /* If we get to here, it should be OK to actually spawn the fishy: */
+  free_fish_strips(&fish_object[*fishies]);
   fish_object[*fishies].word = new_word;
   fish_object[*fishies].len = wcslen(new_word); //using wchar_t[] now
   fish_object[*fishies].alive = 1;
@@ -1182,6 +1186,9 @@ static void SpawnFishies(int diflevel, int* fishies, int* frame)
   fish_object[*fishies].x = rand() % (screen->w - fish_object[*fishies].w);
   fish_object[*fishies].y = 0;
 
+  /* Compose the fish now rather than in the middle of a frame: */
+  fish_strip(&fish_object[*fishies], 0);
+
   /* set the percentage of the speed based on length */
   fish_object[*fishies].dy = pow(0.92, fish_object[*fishies].len - 1);
   /* ex: a 9 letter word will be roughly twice as slow! 0.92^8 */
@@ -1325,6 +1332,7 @@ static void AddSplat(int* splats, struct fishypoo* f, int* curlives, int* frame)
   }
 
   f->alive = 0;
+  free_fish_strips(f);
 
   *curlives = *curlives - 1;
 
@@ -1351,47 +1359,223 @@ static int RTL()
 
 
 
-static void DrawFish(int which)
+/* Where the letter in position 'j' of 'f' goes within its letter layer: */
+#define FISH_X_INSET 5
+#define FISH_Y_INSET 0
+
+static int strip_letter_x(struct fishypoo* f, int j)
 {
-  int j = 0;
-  int red_letters = 0;
-  int current_letter;
-  /* 'x_inset' and 'y_inset' are where the glyph to be drawn relative        */
-  /* the fish_sprite graphic:                                                      */
-  const int x_inset = 5;
-  const int y_inset = 0;
-  /* letter_x and letter_y are where the upper left corner of the glyph needs */
-  /* to be located - (e.g. how SDL blitting understands locations)           */
-  int letter_x = 0;
-  int letter_y = 0;
+  if (RTL())
+    j = f->len - 1 - j;
+  return j * fish_sprite->frame[0]->w + FISH_X_INSET;
+}
 
-  LOG ("Entering DrawFish()\n\n");
 
-  SDL_Surface* letter_surface;
+/* A fish's body depends only on its length and the animation frame, */
+/* so body strips are shared by all fish: body_strips[] holds one per */
+/* (length, fish_sprite frame), built the first time it is needed.    */
+static SDL_Surface** body_strips = NULL;
+static int body_strips_len = 0;   /* longest length with room in body_strips[] */
 
-  /* Make sure needed pointers are valid - if not, return: */
-  if (!fish_sprite || !fish_sprite->frame[0])
+
+/* Body strip for a fish of 'len' letters at fish_sprite's current frame: */
+static SDL_Surface* fish_body(int len)
+{
+  SDL_Surface* body;
+  SDL_Surface** strip;
+  SDL_PixelFormat* fmt;
+  int frames, fw, j;
+
+  if (!fish_sprite || !fish_sprite->frame[0] || len < 1)
+    return NULL;
+
+  frames = fish_sprite->num_frames;
+  if (frames < 1)
+    frames = 1;
+
+  if (len > body_strips_len)
   {
-    fprintf(stderr, "DrawFish() - returning, needed pointer invalid\n");
+    SDL_Surface** more = realloc(body_strips, len * frames * sizeof(SDL_Surface*));
+    if (!more)
+    {
+      fprintf(stderr, "fish_body() - out of memory\n");
+      return NULL;
+    }
+    memset(more + body_strips_len * frames, 0,
+           (len - body_strips_len) * frames * sizeof(SDL_Surface*));
+    body_strips = more;
+    body_strips_len = len;
+  }
+
+  strip = &body_strips[(len - 1) * frames + fish_sprite->cur % frames];
+  if (*strip)
+    return *strip;
+
+  body = fish_sprite->frame[fish_sprite->cur];
+  fw = fish_sprite->frame[0]->w;
+  fmt = body->format;
+  *strip = SDL_CreateRGBSurface(SDL_SWSURFACE | SDL_SRCALPHA,
+                                fw * (len - 1) + body->w, body->h, 32,
+                                fmt->Rmask, fmt->Gmask, fmt->Bmask,
+                                fmt->Amask ? fmt->Amask : 0xff000000);
+  if (!*strip)
+  {
+    fprintf(stderr, "fish_body() - could not create surface: %s\n",
+            SDL_GetError());
+    return NULL;
+  }
+
+  SDL_FillRect(*strip, NULL, 0);
+  for (j = 0; j < len; j++)
+    BlitOntoAlpha(body, *strip, j * fw, 0);
+
+  return *strip;
+}
+
+
+static void free_fish_bodies(void)
+{
+  int i, frames;
+
+  if (!body_strips)
     return;
+
+  frames = (fish_sprite && fish_sprite->num_frames > 0) ? fish_sprite->num_frames : 1;
+  for (i = 0; i < body_strips_len * frames; i++)
+    if (body_strips[i])
+      SDL_FreeSurface(body_strips[i]);
+  free(body_strips);
+  body_strips = NULL;
+  body_strips_len = 0;
+}
+
+
+/* Frees the composed surfaces of fish 'f', if it has any: */
+static void free_fish_strips(struct fishypoo* f)
+{
+  int i, frames;
+
+  if (!f)
+    return;
+
+  f->drawn = NULL;
+  if (!f->strips)
+    return;
+
+  frames = (fish_sprite && fish_sprite->num_frames > 0) ? fish_sprite->num_frames : 1;
+  for (i = 0; i < frames; i++)
+    if (f->strips[i])
+      SDL_FreeSurface(f->strips[i]);
+  free(f->strips);
+  f->strips = NULL;
+  f->strips_red = -1;
+}
+
+
+/* fish_strip() returns fish 'f' as a single surface for fish_sprite's   */
+/* current frame: the shared body strip with the letters drawn over it,  */
+/* the first 'red_letters' of them in red. It is big enough for any      */
+/* glyph that sticks out past the body. Each frame is composed the first */
+/* time it is needed, and all of them are thrown away when 'red_letters' */
+/* changes. Returns NULL on failure:                                     */
+static SDL_Surface* fish_strip(struct fishypoo* f, int red_letters)
+{
+  SDL_Surface* body;
+  SDL_Surface* glyph;
+  SDL_Surface** strip;
+  SDL_PixelFormat* fmt;
+  int frames, w, h, j;
+
+  if (!f || !f->word || !fish_sprite || !fish_sprite->frame[0])
+    return NULL;
+
+  frames = fish_sprite->num_frames;
+  if (frames < 1)
+    frames = 1;
+
+  if (f->strips && f->strips_red != red_letters)
+    free_fish_strips(f);
+
+  if (!f->strips)
+  {
+    f->strips = calloc(frames, sizeof(SDL_Surface*));
+    if (!f->strips)
+    {
+      fprintf(stderr, "fish_strip() - out of memory\n");
+      return NULL;
+    }
+    f->strips_red = red_letters;
   }
-	    
 
-  LOG ("DrawFish() - drawing fishies:\n");
+  strip = &f->strips[fish_sprite->cur % frames];
+  if (*strip)
+    return *strip;
 
-  /* Draw the fishies: */
-  for (j = 0; j < fish_object[which].len; j++)
+  body = fish_body(f->len);
+  if (!body)
+    return NULL;
+
+  /* Make room for any glyph that sticks out past its segment: */
+  w = body->w;
+  h = body->h;
+  for (j = 0; j < f->len; j++)
   {
-    DrawSprite( fish_sprite,
-                fish_object[which].x + (fish_sprite->frame[0]->w * j),
-                fish_object[which].y);
+    glyph = GetWhiteGlyph(f->word[j]);
+    if (!glyph)
+      continue;
+    if (strip_letter_x(f, j) + glyph->w > w)
+      w = strip_letter_x(f, j) + glyph->w;
+    if (FISH_Y_INSET + glyph->h > h)
+      h = FISH_Y_INSET + glyph->h;
   }
 
-  LOG ("DrawFish() - drawing letters:\n");
+  fmt = body->format;
+  *strip = SDL_CreateRGBSurface(SDL_SWSURFACE | SDL_SRCALPHA, w, h, 32,
+                                fmt->Rmask, fmt->Gmask, fmt->Bmask, fmt->Amask);
+  if (!*strip)
+  {
+    fprintf(stderr, "fish_strip() - could not create surface: %s\n",
+            SDL_GetError());
+    return NULL;
+  }
+
+  /* Start from a fully transparent surface: */
+  SDL_FillRect(*strip, NULL, 0);
+  BlitOntoAlpha(body, *strip, 0, 0);
+
+  for (j = 0; j < f->len; j++)
+  {
+    if (j < red_letters)
+      glyph = GetRedGlyph(f->word[j]);
+    else
+      glyph = GetWhiteGlyph(f->word[j]);
+
+    if (glyph)
+      BlitOntoAlpha(glyph, *strip, strip_letter_x(f, j), FISH_Y_INSET);
+  }
+
+  return *strip;
+}
+
+
+static void DrawFish(int which)
+{
+  int j = 0;
+  int red_letters = -1;
+  struct fishypoo* f = &fish_object[which];
+  SDL_Surface* surf;
+
+  LOG ("Entering DrawFish()\n\n");
+
+  /* Make sure needed pointers are valid - if not, return: */
+  if (!fish_sprite || !fish_sprite->frame[0])
+  {
+    fprintf(stderr, "DrawFish() - returning, needed pointer invalid\n");
+    return;
+  }
 
-  /* Now we draw the letters on top of the fish: */
-  /* we only draw the letter if tux cannot eat it yet */
-  if (!fish_object[which].can_eat)
+  /* We only draw the letters if tux cannot eat the fish yet: */
+  if (!f->can_eat)
   {
     red_letters = -1;
     j = 0;
@@ -1402,7 +1586,7 @@ static void DrawFish(int which)
       int k;
       for (k = 0; k < tux_object.wordlen - j; k++)
       {
-        if (fish_object[which].word[k] != tux_object.word[j + k]) 
+        if (f->word[k] != tux_object.word[j + k]) 
           k = 100000;
       }
 
@@ -1412,32 +1596,23 @@ static void DrawFish(int which)
         j++;
     }
 
+    if (red_letters < 0)
+      red_letters = 0;
+  }
 
-    LOG ("Now draw each letter:\n");
-
-    int length = wcslen(fish_object[which].word);
-    for (j = 0; j < length; j++)
-    {
-      current_letter = (int)fish_object[which].word[j];
-
-      if (j < red_letters)
-        letter_surface = GetRedGlyph(current_letter);
-      else
-        letter_surface = GetWhiteGlyph(current_letter);
-
-      /* Set "letter_x" and "letter_y to where we want the letter drawn: */
-      letter_x = fish_object[which].x + (j * fish_sprite->frame[0]->w) + x_inset;
+  /* One blit per fish - just the body once its letters are hidden: */
+  if (red_letters >= 0)
+    surf = fish_strip(f, red_letters);
+  else
+    surf = fish_body(f->len);
 
-      if (RTL())
-	letter_x = fish_object[which].x + ((length-1-j) * fish_sprite->frame[0]->w) + x_inset;
+  if (!surf)
+    return;
 
-      letter_y = fish_object[which].y + y_inset;
+  DrawObject(surf, f->x, f->y);
+  f->drawn = surf;
 
-      if(letter_surface != NULL)
-        DrawObject(letter_surface, letter_x, letter_y);
-    }
-  }
-        LOG ("Leaving DrawFish()\n");
+  LOG ("Leaving DrawFish()\n");
 }
 
 /****************************
@@ -1447,7 +1622,7 @@ to their settings
 *****************************/
 static void MoveFishies(int *fishies, int *splats, int *lifes, int *frame)
 {
-  int i, j;
+  int i;
 
   LOG("\nEntering MoveFishies()\n");
 
@@ -1455,8 +1630,9 @@ static void MoveFishies(int *fishies, int *splats, int *lifes, int *frame)
   {
     if (fish_object[i].alive) 
     {
-      for (j = 0; j < fish_object[i].len; j++)
-        EraseSprite( fish_sprite, fish_object[i].x + (fish_sprite->frame[0]->w*j), fish_object[i].y );
+      /* Erase whatever was drawn last, letters and all: */
+      if (fish_object[i].drawn)
+        EraseObject(fish_object[i].drawn, fish_object[i].x, fish_object[i].y);
 	            
       fish_object[i].y += fish_object[i].dy;
 	
@@ -1534,7 +1710,7 @@ perform appropriate action
 ***************************/
 static void CheckCollision(int fishies, int *fish_left, int frame )
 {
-  int i, j;
+  int i;
 
   LOG("\nEntering CheckCollision()\n");
 
@@ -1549,8 +1725,9 @@ static void CheckCollision(int fishies, int *fish_left, int frame )
 				fish_object[i].alive = 0;
 				fish_object[i].can_eat = 0;
 
-				for (j = 0; j < fish_object[i].len; j++) 
-					EraseSprite(fish_sprite, (fish_object[i].x + (j * fish_sprite->frame[0]->w)), fish_object[i].y);
+				if (fish_object[i].drawn)
+					EraseObject(fish_object[i].drawn, fish_object[i].x, fish_object[i].y);
+				free_fish_strips(&fish_object[i]);
 
 				*fish_left = *fish_left - 1;
 
@@ -1780,216 +1957,148 @@ static void HandleKey(SDL_keysym* key_sym)
   } /* while(*im_cp) */
 }
 
+/**********************************************************************
+ * Appends "WORD. " and then, unless the word is a single letter,
+ * "W. O. R. D. " starting from letter "from".
+ * *******************************************************************/
+static void add_spelled_word(wstr_builder* sb, const wchar_t* word, int from)
+{
+	int j,len;
+
+	len = wcslen(word);
+	wsb_add_n(sb,word,len);
+	wsb_add(sb,L". ");
+
+	//Appending letters if word is not alphabet
+	if (1<len)
+	{
+		for(j=from;j<len;j++)
+		{
+			wsb_add_char(sb,word[j]);
+			wsb_add(sb,L". ");
+		}
+	}
+}
+
+/* Pitch and rate go with the fish's height, from 30 up to 60 */
+static int fish_pitch(int which)
+{
+	int pitch_and_rate;
+
+	pitch_and_rate = ((fish_object[which].y*100)/(screen->h - fish_sprite->frame[0]->h));
+	if (pitch_and_rate < 30)
+		pitch_and_rate = 30;
+	if (pitch_and_rate > 60)
+		pitch_and_rate = 60;
+	return pitch_and_rate;
+}
+
 /**********************************************************************
  * This function will announce the bottum most word's in the screen
  * when one starts typing, the remaining letters will be announced 
  * till the word end's 
+ * Called from the game loop, which posts the text to the announcer
+ * thread (see announcer.c) - the thread never reads fish_object[].
+ * A new round is posted whenever the announcer has gone quiet, or
+ * at once when the typed word changes.
  * *******************************************************************/
-static int tts_announcer(void *struct_address)
+static void queue_announcements(int fishies)
 {
-	struct tts_announcer_cascade_data_struct struct_with_data_address = *((struct tts_announcer_cascade_data_struct*)(struct_address));
-	int fishies,i,j,iter;
-	wchar_t buffer[3000];
-	int fish_object_positions[10];
-	int alive,temp;
-	int pitch_and_rate;
+	static int last_wordlen = -1;
+	wchar_t storage[ANNOUNCE_TEXT_LEN];
+	wstr_builder buffer;
+	int nearest[3];
+	int n,i,j;
 	int which,correct_position;
-	tts_announcer_switch = 1;
-	int max;
-	
-	while(1)
+
+	if (tux_object.wordlen != last_wordlen)
 	{
-		//Converting and taking the value of fishies from void address structure 
-		fishies = *struct_with_data_address.address_of_fishies;
-		
-		if(tts_announcer_switch == 0)
-			goto end; 
-		else if(tts_announcer_switch == 2)
-		{
-			T4K_Tts_say(DEFAULT_VALUE,DEFAULT_VALUE,INTERRUPT,"fish_left %d!",fish_left);
-			SDL_Delay(20);
-			T4K_Tts_wait();
-			tts_announcer_switch = 1;
-		}
-		else if(tts_announcer_switch == 3)
+		//Typing moved on, so what is still queued is out of date
+		last_wordlen = tux_object.wordlen;
+		ClearAnnouncements();
+	}
+	else if (!AnnouncerIdle())
+		return;
+
+	wsb_init(&buffer,storage,ANNOUNCE_TEXT_LEN);
+
+	//Checking the typed
+	if (tux_object.wordlen == 0)
+	{
+		//We have to announce only the three fish which splat first,
+		//otherwise it will make confusion. Keep them in splat order.
+		n = 0;
+		for (i=0;i<fishies;i++)
 		{
-			T4K_Tts_say(DEFAULT_VALUE,DEFAULT_VALUE,INTERRUPT,"%d lives remaining!",curlives);
-			SDL_Delay(20);
-			T4K_Tts_wait();
-			tts_announcer_switch = 1;
-		}			
-		
-		
-		//Wait to finish saying the previus word	
-		T4K_Tts_wait();
-		
-		
-		//Checking the typed
-		if (tux_object.wordlen == 0)
-		{	
-			//Adding the iter of each fish wich are alive and not can_eat
-			for(i=0,j=0;i<fishies;i++)
+			if (fish_object[i].can_eat || !fish_object[i].alive)
+				continue;
+			for (j=n;j>0 && fish_object[nearest[j-1]].splat_time > fish_object[i].splat_time;j--)
 			{
-				if (!fish_object[i].can_eat && fish_object[i].alive)
-				{
-					fish_object_positions[j]  = i; 
-					j++;
-				}
+				if (j < 3)
+					nearest[j] = nearest[j-1];
 			}
-			alive = j-1;
-
-			//Ordering the fish_object_positions with respect to splat time		
-			if (alive != 0)
+			if (j < 3)
 			{
-				for (i=alive;i>0;i--)
-				{
-					for (j=0;j<i;j++)
-					{
-						//Comaparing fish_object[i].splat_time;
-						if (fish_object[fish_object_positions[j]].splat_time > fish_object[fish_object_positions[j+1]].splat_time)
-						{
-							temp = fish_object_positions[j];
-							fish_object_positions[j] = fish_object_positions[j+1];
-							fish_object_positions[j+1] = temp;
-						}
-					}
-				}
+				nearest[j] = i;
+				if (n < 3)
+					n++;
 			}
-			
-			//We have to announce only last three otherwise it will make confusion.  
-			if (alive >= 3)
-				max = 2;
-			else
-				max = alive;
+		}
 
-			//Using this corrected order to say each words and letters
-			for(i=0;i<=max;i++)
-			{
-				if(tts_announcer_switch == 0)
-					goto end;
-												
-				//Adding the word
-				wcscpy(buffer,fish_object[fish_object_positions[i]].word);
-				iter = wcslen(fish_object[fish_object_positions[i]].word);
-				buffer[iter] = L'.';iter++;
-				buffer[iter] = L' ';iter++;
-				
-				//Appending letters if word is not alphabet
-				if (1<wcslen(fish_object[fish_object_positions[i]].word))
-				{
-					for(j=0;j<wcslen(fish_object[fish_object_positions[i]].word);j++)
-					{
-						buffer[iter] = fish_object[fish_object_positions[i]].word[j];iter++;
-						buffer[iter] = L'.';iter++;
-						buffer[iter] = L' ';iter++;
-					}
-				}
-				//If not ended with '\0' it will say grabage values also
-				buffer[iter] = L'\0'; 
-				
-				//Setting the pitch and rate with respect to y axis
-				pitch_and_rate = ((fish_object[fish_object_positions[i]].y*100)/(screen->h - fish_sprite->frame[0]->h));
-				
-				if (pitch_and_rate < 30)
-					pitch_and_rate = 30;
-				
-				if (pitch_and_rate > 60)
-					pitch_and_rate = 60;
-				
-				T4K_Tts_say(pitch_and_rate,pitch_and_rate,INTERRUPT,"%S",buffer);
-
-				SDL_WaitThread(tts_thread,NULL);
-				SDL_Delay(100);
-			}				
+		//Using this order to say each words and letters
+		for (i=0;i<n;i++)
+		{
+			wsb_reset(&buffer);
+			add_spelled_word(&buffer,fish_object[nearest[i]].word,0);
+			AnnounceText(wsb_str(&buffer),fish_pitch(nearest[i]));
 		}
-		else
+	}
+	else
+	{
+		//Detecting the corrent typing fish
+		which = -1;
+		for (i=0;i<fishies;i++)
 		{
-			//Detecting the corrent typing fish
-			which = -1;
-			for (i=0;i<fishies;i++)
+			if (!fish_object[i].can_eat && fish_object[i].alive)
 			{
-				//Comaparing fish_object[i].splat_time;
-				if (!fish_object[i].can_eat && fish_object[i].alive)
-				{
-					j = wcsncmp(fish_object[i].word,tux_object.word,tux_object.wordlen);
-					if (j == 0)
-						which = i;		
-				}
+				if (0 == wcsncmp(fish_object[i].word,tux_object.word,tux_object.wordlen))
+					which = i;
 			}
+		}
 
-			if (which != -1)
+		if (which != -1)
+		{
+			//Adding the remaining letters to be announced.
+			//This is as per my PAPA's suggestion (sathyan)  
+			//Eg : "BLUE. B. L. U. E"
+		
+			//Detecting the correct_position
+			correct_position = 0;
+			for(j=0;j<tux_object.wordlen;j++)
 			{
-				//Adding the word
-				wcscpy(buffer,fish_object[which].word);
-				iter = wcslen(fish_object[which].word);
-				buffer[iter] = L'.';iter++;
-				buffer[iter] = L' ';iter++;
-			
-				//Adding the remaining letters to be announced.
-				//This is as per my PAPA's suggestion (sathyan)  
-				//Eg : "BLUE. B. L. U. E"
-			
-				//Detecting the correct_position
-				correct_position = 0;
-				for(j=0;j<tux_object.wordlen;j++)
+				if (tux_object.word[j] == fish_object[which].word[j])
 				{
-					if (tux_object.word[j] == fish_object[which].word[j])
-					{
-						correct_position+=1;
-					}
-					else
-					{
-						tux_object.wordlen = 0;
-						tux_object.word[0] = L'\0';
-						break;
-					}
-				
+					correct_position+=1;
 				}
-				//Appending each letters from correct_position if word is not alphabet
-				if (1<wcslen(fish_object[which].word))
+				else
 				{
-					for(j=correct_position;j<wcslen(fish_object[which].word);j++)
-					{
-						//Skipping if the letter is in orange color. if not it will be appended
-						buffer[iter] = fish_object[which].word[j];iter++;
-						buffer[iter] = L'.';iter++;
-						buffer[iter] = L' ';iter++;
-					}
+					tux_object.wordlen = 0;
+					tux_object.word[0] = L'\0';
+					break;
 				}
-				//If not ended with '\0' it will say grabage values also
-				buffer[iter] = L'\0';
-				
-				//Setting the pitch and rate with respect to y axis
-				pitch_and_rate = ((fish_object[which].y*100)/(screen->h - fish_sprite->frame[0]->h));
-				
-				if (pitch_and_rate < 30)
-					pitch_and_rate = 30;
-				
-				if (pitch_and_rate > 60)
-					pitch_and_rate = 60;
-				 
-				
-				T4K_Tts_say(pitch_and_rate,pitch_and_rate,INTERRUPT,"%S",buffer);				
-				SDL_WaitThread(tts_thread,NULL);
-				SDL_Delay(100);
-				fprintf(stderr,"\nBraille_Letter_Pos = %d",braille_letter_pos);
 			}
-			else
-			{
-				tux_object.wordlen = 0;
-				tux_object.word[0] = L'\0';
-			}
-		
+
+			//Adding the word, then each letter from correct_position
+			add_spelled_word(&buffer,fish_object[which].word,correct_position);
+			AnnounceText(wsb_str(&buffer),fish_pitch(which));
+			DEBUGCODE {fprintf(stderr,"\nBraille_Letter_Pos = %d",braille_letter_pos);}
+		}
+		else
+		{
+			tux_object.wordlen = 0;
+			tux_object.word[0] = L'\0';
 		}
 	}
-	end:
-	return 0;
-}
-
-/********** Stop annoncing thread safely *********/
-static void stop_tts_announcer()
-{
-	tts_announcer_switch = 0;	
 }
 
 
@@ -112,6 +112,9 @@ struct fishypoo {
     size_t len;
     int    splat_time;
     double dy;
+    SDL_Surface** strips; /* body and letters, one per fish_sprite frame - see fish_strip() */
+    int    strips_red;    /* red letters in 'strips', -1 if none composed yet */
+    SDL_Surface* drawn;   /* what DrawFish() last blitted, for erasing */
 } fish_object[MAX_FISHIES_HARD + 1];
 
 struct fishypoo null_fishy;
@@ -156,12 +159,6 @@ struct splatter {
 
 struct splatter null_splat;
 
-//Structure for passing address of data to threded function 
-struct tts_announcer_cascade_data_struct
-{
-	int *address_of_fishies;
-	int *address_of_tts_pause;
-};
 
 
 
@@ -21,9 +21,12 @@ Sreyas Kurumanghat <k.sreyas@gmail.com>
 *                                                                         *
 ***************************************************************************/
 
+#include <wctype.h>
+
 #include "globals.h"
 #include "funcs.h"
 #include "SDL_extras.h"
+#include "braille.h"
 #include "convert_utf.h"
 
 #define MAX_PHRASES 256
@@ -31,6 +34,9 @@ Sreyas Kurumanghat <k.sreyas@gmail.com>
 #define MAX_WRAP_LINES 10
 #define TEXT_HEIGHT 28
 #define SPRITE_FRAME_TIME 200
+/* A spelled-out word can be ~12 wide chars per letter ("Capitol X "): */
+#define TTS_WORD_BUFFER_LEN (MAX_PHRASE_LENGTH * 16)
+
 /* "Local globals" for practice.c */
 static int fontsize = 0;
 static int medfontsize = 0;
@@ -44,6 +50,9 @@ static SDL_Surface* keypress1 = NULL;
 static SDL_Surface* keypress2 = NULL;
 static SDL_Surface* hand[11] = {NULL};
 static SDL_Surface* braille_hand[65] = {NULL};
+/* hands + finger + shift composites for the hint, made as needed and */
+/* indexed by [finger][shift] - finger 10 means "no finger":           */
+static SDL_Surface* hand_hint[11][3] = {{NULL}};
 static sprite* tux_stand = NULL;
 static sprite* tux_win = NULL;
 static SDL_Surface* time_label_srfc = NULL;
@@ -54,6 +63,20 @@ static SDL_Surface* errors_label_srfc = NULL;
 static SDL_Surface* accuracy_label_srfc = NULL;
 
 
+/* Keyboard overlay images (keyboard_<key>.png, keyboardN_<key>.png and */
+/* the shift overlays), loaded the first time each is needed and kept   */
+/* until practice_unload_media(), looked up by file name:               */
+#define KEY_IMAGE_BUCKETS 64
+
+typedef struct key_image {
+  char fn[50];
+  SDL_Surface* img;   /* NULL if the file could not be loaded */
+  struct key_image* next;
+} key_image;
+
+static key_image* key_images[KEY_IMAGE_BUCKETS] = {NULL};
+
+
 static wchar_t phrases[MAX_PHRASES][MAX_PHRASE_LENGTH];
 static Mix_Chunk* wrong = NULL;
 static Mix_Chunk* cheer = NULL;
@@ -112,6 +135,11 @@ SDL_Surface* GetKeypress2(int index);
 SDL_Surface* GetWrongKeypress(int index);
 static void print_load_results(void);
 static void set_hand(int cursor,int cur_phrase);
+static struct braille_dict* braille_entry_for(wchar_t c, int* chord);
+static wchar_t braille_chord_value(struct braille_dict* entry, wchar_t expected);
+static SDL_Surface* get_key_image(const char* fn);
+static void free_key_images(void);
+static SDL_Surface* get_hand_hint(int fing, int shift);
 wchar_t *get_next_word_letters(int cur_phrase,int cursor,int till_next_space);
 wchar_t *get_next_word(int cur_phrase,int cursor);
 
@@ -636,40 +664,33 @@ int Phrases(wchar_t* pphrase )
 				if (wcscmp(pressed_letters,L" ") != 0)
 				{
 					/* ------ Check pressed_letters which is not space --------*/
-					arrange_in_order(pressed_letters);
-					if (wcscmp(pressed_letters,L"") != 0)
+					int chord = braille_chord_from_keys(pressed_letters);
+					if (chord)
 					{
-						for(i=0;i<100;i++)
+						struct braille_dict* chord_entry = braille_chord_lookup(chord);
+						if (chord_entry)
 						{
-							if (wcscmp(pressed_letters,braille_key_value_map[i].key) == 0)
-							{
-								if (braille_letter_pos == 0)
-									tmp = braille_key_value_map[i].value_begin[0];
-								else if (braille_letter_pos == 1)
-									tmp = braille_key_value_map[i].value_middle[0];
-								else
-									tmp = braille_key_value_map[i].value_end[0];
-								
-								check_key = 1;
-								if (braille_capital)
-									{
-										shift_pressed = 1;
-										braille_capital = 0;
-									}
-								if (braille_numbers)
-									{
-										braille_numbers = 0;
-										char file_name[100];
-										if(settings.use_english){
-											sprintf(file_name,"english.txt");
-											}
-										else{
-											sprintf(file_name,"%s.txt",settings.theme_name);
-											}
-										braille_language_loader(file_name);
-									}									
-							}
-						}	   
+							tmp = braille_chord_value(chord_entry, phrases[cur_phrase][cursor]);
+							
+							check_key = 1;
+							if (braille_capital)
+								{
+									shift_pressed = 1;
+									braille_capital = 0;
+								}
+							if (braille_numbers)
+								{
+									braille_numbers = 0;
+									char file_name[100];
+									if(settings.use_english){
+										sprintf(file_name,"english.txt");
+										}
+									else{
+										sprintf(file_name,"%s.txt",settings.theme_name);
+										}
+									braille_language_loader(file_name);
+								}									
+						}
 					}
 					
 					/* --- Preventing the checking of Remaining KEYUP events --- */ 
@@ -916,10 +937,8 @@ int Phrases(wchar_t* pphrase )
             keypress1= GetWrongKeypress(key);
           
             if (keypress1) // avoid segfault if NULL
-            {
               SDL_BlitSurface(keypress1, NULL, screen, &keyboard_loc);
-              SDL_FreeSurface(keypress1);
-            }
+            keypress1 = NULL;
           }
           state = 2;
 
@@ -944,50 +963,27 @@ int Phrases(wchar_t* pphrase )
 				else
 				{
 						  
-						  int j,len;
+						  int j,len,chord;
 						  wchar_t tts_temp[255];
 						  tts_temp[0] = L'\0';
 						  len = 0;
 						  
 						  /* hear we check for the keycombination of the next letter to be typed */
-						  for (i=0;i<100;i++)
+						  if (braille_entry_for(phrases[cur_phrase][cursor], &chord))
 						  {
-							  /* We have to check each case because braille combination is same for
-							   * begining,middle and end of the word in which letters are not same */
-							   if (braille_key_value_map[i].value_begin[0] == phrases[cur_phrase][cursor] 
-								||  braille_key_value_map[i].value_middle[0] == phrases[cur_phrase][cursor]
-								||  braille_key_value_map[i].value_end[0] == phrases[cur_phrase][cursor] 
-								||  (settings.use_english == 1 && braille_key_value_map[i].value_begin[0] 
-													== tolower(phrases[cur_phrase][cursor])))
-								{
-									/* This is working with a six bit binary system */
-									
-									for(j=0;j<wcslen(braille_key_value_map[i].key);j++)
-									{
-										if (braille_key_value_map[i].key[j] == 'f')
-											tts_temp[len] = L'1';
-										if (braille_key_value_map[i].key[j] == 'd')
-											tts_temp[len] = L'2';						
-										if (braille_key_value_map[i].key[j] == 's')
-											tts_temp[len] = L'3';
-										if (braille_key_value_map[i].key[j] == 'j')
-											tts_temp[len] = L'4';																
-										if (braille_key_value_map[i].key[j] == 'k')
-											tts_temp[len] = L'5';					
-										if (braille_key_value_map[i].key[j] == 'l')
-											tts_temp[len] = L'6';
-										len++;
-										tts_temp[len] = L' ';
-										len++;
-										tts_temp[len] = L',';
-										len++;
-									}
-									tts_temp[len] = L'\0';
-									T4K_Tts_say(DEFAULT_VALUE,DEFAULT_VALUE,INTERRUPT,"Type %S with dot %S",get_next_word_letters(cur_phrase,cursor,0),tts_temp);
-									tts_temp[0] = L'\0';
-						
-								}
-							}
+							  /* This is working with a six bit binary system - */
+							  /* bit j of the chord is dot j + 1:               */
+							  for(j=0;j<6;j++)
+							  {
+								  if (!(chord & (1 << j)))
+									  continue;
+								  tts_temp[len++] = L'1' + j;
+								  tts_temp[len++] = L' ';
+								  tts_temp[len++] = L',';
+							  }
+							  tts_temp[len] = L'\0';
+							  T4K_Tts_say(DEFAULT_VALUE,DEFAULT_VALUE,INTERRUPT,"Type %S with dot %S",get_next_word_letters(cur_phrase,cursor,0),tts_temp);
+						  }
 					  }
 				  }
           }
@@ -1355,6 +1351,19 @@ static void practice_unload_media(void)
     hand[i] = NULL;
   }
 
+  for (i = 0; i < 11; i++)
+  {
+    int j;
+    for (j = 0; j < 3; j++)
+    {
+      if (hand_hint[i][j])
+        SDL_FreeSurface(hand_hint[i][j]);
+      hand_hint[i][j] = NULL;
+    }
+  }
+
+  free_key_images();
+
   if (tux_stand)
   {
     FreeSprite(tux_stand);
@@ -1465,18 +1474,16 @@ static int load_phrases(const char* phrase_file)
 
 /* Returns index relative to wstr of last char to be printed before break.  */
 /* (i.e. end of last full word that fits within 'width'                     */
+/* Each candidate line is measured once per word boundary with              */
+/* TextWidth_w(), which sizes the text without rendering it.                */
 static int find_next_wrap(const wchar_t* wstr, int font_size, int width)
 {
-  wchar_t buf[MAX_PHRASE_LENGTH];
-  char UTF8buf[MAX_PHRASE_LENGTH];
-  SDL_Surface* s = NULL;
   int word_end = -1;
   int prev_word_end = -1;
 
   int i = 0;
   int phr_length = 0;
-  int test_w = 0;      /* The width in pixels of the SDL-rendered string */
-  /* FIXME get rid of this once overhaul done: */
+  int test_w = 0;      /* The width in pixels of wstr[0] through wstr[word_end] */
 
   LOG("Entering find__next_wrap\n");
 
@@ -1493,8 +1500,6 @@ static int find_next_wrap(const wchar_t* wstr, int font_size, int width)
   phr_length = wcslen(wstr);
 
   DOUT(phr_length);
-  /* Using 'MAX_PHRASE_LENGTH - 1' will make sure our copied string is   */
-  /* null-terminated, even if it didn't fit.                             */
 
   if (phr_length > (MAX_PHRASE_LENGTH - 1))
   {
@@ -1503,57 +1508,39 @@ static int find_next_wrap(const wchar_t* wstr, int font_size, int width)
   }
 
   /* The function will eventually return from within the loop */
-  while(1)
+  for (i = 0; ; i++)
   {
-    /* Find next either next space or end of string to check width */
-    for( ; 
-        i < phr_length  &&  wstr[i] != ' ';
-        i++);
-
-    DOUT(i);
-
-    /* If exited because space found, back up one so we are at last char in word: */
-    if (wstr[i] == ' ')
-      word_end = i - 1;
-    else
-      word_end = i;
-
-    /* See if we have exceeded the width */
-    /* Copy string into buf and null terminate after point to be checked: */
-    wcsncpy(buf, wstr, MAX_PHRASE_LENGTH);
-    buf[word_end + 1] = '\0';
-    DEBUGCODE{ fprintf(stderr, "buf = %S\n", buf);}
-
-    /* Need to convert to UTF8 because couldn't get UNICODE version to work: */
-    ConvertToUTF8(buf, UTF8buf, MAX_PHRASE_LENGTH);
-    /*  Now check width of string: */
-    s = SimpleText(UTF8buf, font_size, &white);
-    if (!s)
+    /* Check the width at each space and at the end of the string: */
+    if (i >= phr_length || wstr[i] == ' ')
     {
-      /* An error occurred: */
-      return -1;
-    }
+      /* If at a space, back up one so we are at last char in word: */
+      if (i < phr_length)
+        word_end = i - 1;
+      else
+        word_end = i;
 
-    test_w = s->w;
-    SDL_FreeSurface(s);
-    s = NULL;
+      test_w = TextWidth_w(wstr, word_end + 1, font_size);
+      if (test_w < 0)
+      {
+        /* An error occurred: */
+        return -1;
+      }
 
-    DOUT(test_w);
-    DOUT(width);
-    /* If we've gone past the width, the previous space was the wrap point, */
-    /* whether or not we are at the end of the string:                      */
-    if (test_w > width)
-    {
-      DEBUGCODE
+      DOUT(test_w);
+      DOUT(width);
+      /* If we've gone past the width, the previous space was the wrap point, */
+      /* whether or not we are at the end of the string:                      */
+      if (test_w > width)
       {
-        fprintf(stderr, "width exceeded, returning end of previous word as wrap point\n");
-        fprintf(stderr, "prev_word_end is %d\n", prev_word_end); 
-        fprintf(stderr, "leaving find_next_wrap()\n");
+        DEBUGCODE
+        {
+          fprintf(stderr, "width exceeded, returning end of previous word as wrap point\n");
+          fprintf(stderr, "prev_word_end is %d\n", prev_word_end); 
+          fprintf(stderr, "leaving find_next_wrap()\n");
+        }
+        return prev_word_end; 
       }
-      return prev_word_end; 
-    }
-    else
-    {
+
       if (i >= phr_length)
       {
         DEBUGCODE
@@ -1565,11 +1552,8 @@ static int find_next_wrap(const wchar_t* wstr, int font_size, int width)
         /* so just return our current position: */ 
         return word_end;
       }
-      else
-      {
-        prev_word_end = word_end;
-        i++;
-      }
+
+      prev_word_end = word_end;
     }
   }
 }
@@ -1601,28 +1585,109 @@ static void display_next_letter(const wchar_t *str, Uint16 index)
 }
 
 
+/* These return cached images - the caller must not free them: */
 SDL_Surface* GetKeypress1(int index)
 {
-	char buf[50];
+	char buf[50] = "";
 	GetKeyPos(index,buf);
-	return (LoadImage(buf, IMG_ALPHA));
+	return get_key_image(buf);
 }
 
 
 SDL_Surface* GetWrongKeypress(int index)
 {
-	char buf[50];
+	char buf[50] = "";
 	GetWrongKeyPos(index,buf);
-	return (LoadImage(buf, IMG_ALPHA));
+	return get_key_image(buf);
 }
 
 
 SDL_Surface* GetKeypress2(int index)
 {
  
-	char buf[50];
+	char buf[50] = "";
 	GetKeyShift(index, buf);
-	return (LoadImage(buf, IMG_ALPHA));
+	return get_key_image(buf);
+}
+
+
+/* Returns the image in 'fn', loading it only the first time it is asked for: */
+static SDL_Surface* get_key_image(const char* fn)
+{
+  unsigned int h = 0;
+  const char* p;
+  key_image* k;
+
+  if (!fn || !fn[0])
+    return NULL;
+
+  for (p = fn; *p; p++)
+    h = h * 31 + (unsigned char)*p;
+  h %= KEY_IMAGE_BUCKETS;
+
+  for (k = key_images[h]; k; k = k->next)
+    if (0 == strcmp(k->fn, fn))
+      return k->img;
+
+  k = malloc(sizeof(key_image));
+  if (!k)
+    return NULL;
+  strncpy(k->fn, fn, sizeof(k->fn) - 1);
+  k->fn[sizeof(k->fn) - 1] = '\0';
+  /* Remember failures too, so we don't keep looking for a missing file: */
+  k->img = LoadImage(fn, IMG_ALPHA);
+  k->next = key_images[h];
+  key_images[h] = k;
+
+  return k->img;
+}
+
+
+static void free_key_images(void)
+{
+  int i;
+
+  for (i = 0; i < KEY_IMAGE_BUCKETS; i++)
+  {
+    while (key_images[i])
+    {
+      key_image* k = key_images[i];
+      key_images[i] = k->next;
+      if (k->img)
+        SDL_FreeSurface(k->img);
+      free(k);
+    }
+  }
+}
+
+
+/* Returns the hands image with finger 'fing' (or none if -1) and shift */
+/* overlay 'shift' drawn onto it, making it the first time. Returns     */
+/* NULL if it can't be made, so the caller can draw the layers itself:  */
+static SDL_Surface* get_hand_hint(int fing, int shift)
+{
+  SDL_Surface* s;
+  int f = (fing >= 0 && fing < 10) ? fing : 10;
+
+  if (shift < 0 || shift > 2 || !hands)
+    return NULL;
+
+  if (hand_hint[f][shift])
+    return hand_hint[f][shift];
+
+  s = SDL_ConvertSurface(hands, hands->format, SDL_SWSURFACE);
+  if (!s)
+    return NULL;
+
+  if ((f < 10 && hand[f] && !BlitOntoAlpha(hand[f], s, 0, 0))
+   || (hand_shift[shift] && !BlitOntoAlpha(hand_shift[shift], s, 0, 0)))
+  {
+    SDL_FreeSurface(s);
+    return NULL;
+  }
+
+  hand_hint[f][shift] = s;
+  return s;
 }
 
 static int create_labels(void)
@@ -1663,43 +1728,92 @@ static int create_labels(void)
 }
 
 
+/* Braille map entry for the letter 'c' and its chord, also trying */
+/* lower case in English (whose map only has lower case letters):   */
+static struct braille_dict* braille_entry_for(wchar_t c, int* chord)
+{
+  struct braille_dict* entry = braille_char_lookup(c, chord);
+
+  if (!entry && settings.use_english == 1)
+  {
+    entry = braille_char_lookup(towlower(c), chord);
+    /* (only the beginning value counts for this) */
+    if (entry && entry->value_begin[0] != towlower(c))
+      entry = NULL;
+  }
+  return entry;
+}
+
+
+/* Character typed by the chord whose first map entry is 'entry'.  */
+/* When several entries share the chord, the one which can give    */
+/* the 'expected' letter wins; otherwise the last entry is used    */
+/* at the current braille_letter_pos.                              */
+static wchar_t braille_chord_value(struct braille_dict* entry, wchar_t expected)
+{
+  struct braille_dict* last = entry;
+  wchar_t lower = towlower(expected);
+
+  for (; entry; entry = braille_chord_next(entry))
+  {
+    if (entry->value_begin[0] == expected
+     || entry->value_middle[0] == expected
+     || entry->value_end[0] == expected)
+      return expected;
+    /* (English maps only have lower case letters) */
+    if (settings.use_english == 1 && entry->value_begin[0] == lower)
+      return lower;
+    last = entry;
+  }
+
+  if (braille_letter_pos == 0)
+    return last->value_begin[0];
+  else if (braille_letter_pos == 1)
+    return last->value_middle[0];
+  else
+    return last->value_end[0];
+}
+
+
 /*****************************************************************
  * Set the finger to the curresponding letter, if braille mode 
  * is enabled fingers will be shown  
  * **************************************************************/
 void set_hand(int cursor,int cur_phrase)
 {
-	int fing,j,i;	
+	int fing;
 	if (!settings.braille)
     {
 			
 			int key = GetIndex(phrases[cur_phrase][cursor]);
 			int fing = GetFinger(key);
 			int shift = GetShift(key);
+			SDL_Surface* hint = get_hand_hint(fing, shift);
 			keypress1 = GetKeypress1(key);
 			keypress2 = GetKeypress2(key);
  
 			SDL_BlitSurface(CurrentBkgd(), &hand_loc, screen, &hand_loc);
-			SDL_BlitSurface(hands, NULL, screen, &hand_loc);
+			if (hint)
+				SDL_BlitSurface(hint, NULL, screen, &hand_loc);
+			else
+			{
+				SDL_BlitSurface(hands, NULL, screen, &hand_loc);
 
-			if (fing >= 0) 
-				SDL_BlitSurface(hand[fing], NULL, screen, &hand_loc);
+				if (fing >= 0) 
+					SDL_BlitSurface(hand[fing], NULL, screen, &hand_loc);
 
-			SDL_BlitSurface(hand_shift[shift], NULL, screen, &hand_loc);
+				if (shift >= 0 && shift <= 2)
+					SDL_BlitSurface(hand_shift[shift], NULL, screen, &hand_loc);
+			}
 
+			/* (cached - not ours to free) */
 			if (keypress1)
-			{
 				SDL_BlitSurface(keypress1, NULL, screen, &keyboard_loc);
-				SDL_FreeSurface(keypress1);
-				keypress1 = NULL;
-			}
+			keypress1 = NULL;
 
 			if (keypress2)
-			{
 				SDL_BlitSurface(keypress2, NULL, screen, &keyboard_loc);
-				SDL_FreeSurface(keypress2);
-				keypress2 = NULL;
-			}
+			keypress2 = NULL;
 	    }
 	    else
 		{
@@ -1715,47 +1829,26 @@ void set_hand(int cursor,int cur_phrase)
 			else
 			{
 				/* hear we check for the keycombination of the next letter to be typed */
-				for (i=0;i<100;i++)
+				wchar_t next = phrases[cur_phrase][cursor];
+				struct braille_dict* entry = braille_entry_for(next, &fing);
+
+				if (entry)
 				{
-					/* We have to check each case because braille combination is same for
-					 * begining,middle and end of the word in which letters are not same */
-					if (braille_key_value_map[i].value_begin[0] == phrases[cur_phrase][cursor] 
-					||  braille_key_value_map[i].value_middle[0] == phrases[cur_phrase][cursor]
-					||  braille_key_value_map[i].value_end[0] == phrases[cur_phrase][cursor] 
-					||  (settings.use_english == 1 && braille_key_value_map[i].value_begin[0] 
-													== tolower(phrases[cur_phrase][cursor])))
-					{
-						/* This is working with a six bit binary system */
-						fing = 0;
-						for(j=0;j<wcslen(braille_key_value_map[i].key);j++)
-						{
-							if (braille_key_value_map[i].key[j] == 'f')
-								fing += 1;
-							if (braille_key_value_map[i].key[j] == 'd')
-								fing += 2;							
-							if (braille_key_value_map[i].key[j] == 's')
-								fing += 4;
-							if (braille_key_value_map[i].key[j] == 'j')
-								fing += 8;																
-							if (braille_key_value_map[i].key[j] == 'k')
-								fing += 16;						
-							if (braille_key_value_map[i].key[j] == 'l')
-								fing += 32;
-						}
-						SDL_BlitSurface(CurrentBkgd(), &hand_loc, screen, &hand_loc);
-						SDL_BlitSurface(hands, NULL, screen, &hand_loc);
-						SDL_BlitSurface(braille_hand[fing], NULL, screen, &hand_loc);
-						
-						/* Setting the letter pos for braille acording to next letter to be typed 
-						 * For some specific language's which have same braille code for
-						 * alphabets and signs at begining, middle and end position.*/
-						if (braille_key_value_map[i].value_end[0] == phrases[cur_phrase][cursor] )
-							braille_letter_pos = 2;
-						else if (braille_key_value_map[i].value_middle[0] == phrases[cur_phrase][cursor] )
-							braille_letter_pos = 1;
-						else
-							braille_letter_pos = 0;					
-					}
+					/* The chord is a six bit binary number, which is also */
+					/* the index of its hand image:                        */
+					SDL_BlitSurface(CurrentBkgd(), &hand_loc, screen, &hand_loc);
+					SDL_BlitSurface(hands, NULL, screen, &hand_loc);
+					SDL_BlitSurface(braille_hand[fing], NULL, screen, &hand_loc);
+					
+					/* Setting the letter pos for braille acording to next letter to be typed 
+					 * For some specific language's which have same braille code for
+					 * alphabets and signs at begining, middle and end position.*/
+					if (entry->value_end[0] == next)
+						braille_letter_pos = 2;
+					else if (entry->value_middle[0] == next)
+						braille_letter_pos = 1;
+					else
+						braille_letter_pos = 0;
 				}
 			}
 				
@@ -1766,16 +1859,18 @@ void set_hand(int cursor,int cur_phrase)
  * get the remaining letter 
  * if till_next_space  is 1 then get lettesrs till a space reached
  * otherwise return only next charecter
+ * The returned string lives in a static buffer and stays valid until the
+ * next call, so no allocation is made per keystroke.
  * *************************************************************************/
 wchar_t *get_next_word_letters(int cur_phrase,int cursor,int till_next_space)
 {
-	int iter,i,len;
-	wchar_t *temp;
+	static wchar_t storage[TTS_WORD_BUFFER_LEN];
+	wstr_builder sb;
+	int i,len;
 	
-	temp = (wchar_t *)malloc(1000);
+	wsb_init(&sb,storage,TTS_WORD_BUFFER_LEN);
 	len = wcslen(phrases[cur_phrase]);
-	temp[0] = L'\0';
-	for(iter=0,i=cursor;i<=len;i++)
+	for(i=cursor;i<len;i++)
 	{
 		//Break if a space found
 		if(phrases[cur_phrase][i] == L' ')
@@ -1783,79 +1878,72 @@ wchar_t *get_next_word_letters(int cur_phrase,int cursor,int till_next_space)
 		
 		if (phrases[cur_phrase][i] == L',')
 		{
-			wcscat(temp,gettext(L"comma"));
+			wsb_add_utf8(&sb,gettext("comma"));
 		}
 		else if (phrases[cur_phrase][i] == L'.')
 		{
-			wcscat(temp,gettext(L"full stop"));
+			wsb_add_utf8(&sb,gettext("full stop"));
 		}
 		else if (phrases[cur_phrase][i] == L'\'')
 		{
-			wcscat(temp,gettext(L"apostophe"));
+			wsb_add_utf8(&sb,gettext("apostophe"));
 		}
 		else if (phrases[cur_phrase][i] == L';')
 		{
-			wcscat(temp,gettext(L"semicolon"));
+			wsb_add_utf8(&sb,gettext("semicolon"));
 		}		
 		else if (phrases[cur_phrase][i] == L':')
 		{
-			wcscat(temp,gettext(L"colon"));
+			wsb_add_utf8(&sb,gettext("colon"));
 		}
 		else if (phrases[cur_phrase][i] == L'?')
 		{
-			wcscat(temp,gettext(L"Qustion mark"));
+			wsb_add_utf8(&sb,gettext("Qustion mark"));
 		}
 		else if (phrases[cur_phrase][i] == L'-')
 		{
-			wcscat(temp,gettext(L"Hyphen"));
+			wsb_add_utf8(&sb,gettext("Hyphen"));
 		}		
 		else
 		{
-			iter = wcslen(temp);
-			temp[iter++] = L' ';
+			wsb_add_char(&sb,L' ');
 			if(iswupper(phrases[cur_phrase][i]))
-			{
-				temp[iter] = L'\0';	
-				wcscat(temp,L"Capitol ");
-				iter+=8;
-			}
-			temp[iter++] = phrases[cur_phrase][i];
-			temp[iter++] = L' ';
-			temp[iter] = L'\0';	
+				wsb_add(&sb,L"Capitol ");
+			wsb_add_char(&sb,phrases[cur_phrase][i]);
+			wsb_add_char(&sb,L' ');
 		}
 		
 		if (till_next_space == 0)
 			break;
 	}
 	//Add space if any
-	if (phrases[cur_phrase][i] == L' ')
+	if (i < len && phrases[cur_phrase][i] == L' ')
 	{
-			wcscat(temp,L" Space");
+			wsb_add(&sb,L" Space");
 	}
 	
-	return temp;				
+	return wsb_str(&sb);
 
 }
 
 /*********************************************************
  * Get the next word 
+ * Like get_next_word_letters(), returns a static buffer.
  ********************************************************/
 wchar_t *get_next_word(int cur_phrase,int cursor)
 {
-	int iter,i,len;
-	wchar_t *temp;
-	temp = (wchar_t *)malloc(1000); 
-	temp[0] = L'\0';
+	static wchar_t storage[TTS_WORD_BUFFER_LEN];
+	wstr_builder sb;
+	int i,len;
 	
+	wsb_init(&sb,storage,TTS_WORD_BUFFER_LEN);
 	len = wcslen(phrases[cur_phrase]);
-	for(iter=0,i=cursor;i<len;i++)
+	for(i=cursor;i<len;i++)
 	{
 		//Break if a space found
 		if(phrases[cur_phrase][i] == L' ')
 			break;
-		temp[iter] = phrases[cur_phrase][i];
-		iter++;								
 	}
-	temp[iter] = L'\0';
-	return temp;
+	wsb_add_n(&sb,phrases[cur_phrase]+cursor,i>cursor?i-cursor:0);
+	return wsb_str(&sb);
 }
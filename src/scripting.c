@@ -29,6 +29,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "scripting.h"
 #define MAX_LESSONS 100
+#define SCRIPT_TTS_BUFFER_LEN 8192
 #include "SDL_extras.h"
 #include "convert_utf.h"
 #include "scandir.h"
@@ -1155,10 +1156,11 @@ static int load_script(const char* fn)
 static void run_script(void)
 {
 	
-  /* Used to announce the Lesson instruction */
-  char *tts_buffer;
-  tts_buffer = malloc(sizeof(char)*1000000);
-  tts_buffer[0] = '\0';
+  /* Used to announce the Lesson instruction - static so that running */
+  /* a lesson does not allocate; text past the end is not spoken.      */
+  static wchar_t tts_storage[SCRIPT_TTS_BUFFER_LEN];
+  wstr_builder tts_buffer;
+  wsb_init(&tts_buffer, tts_storage, SCRIPT_TTS_BUFFER_LEN);
 	
   /* FIXME FNLEN doesn't make sense for size of these arrays */
   Mix_Chunk* sounds[FNLEN] = {NULL};
@@ -1323,7 +1325,7 @@ static void run_script(void)
         case itemTEXT:
         {
 		  /* Append each text line's to the lesson instruction */
-          strcat(tts_buffer,curItem->data);
+          wsb_add_utf8(&tts_buffer,curItem->data);
 	
           SDL_Surface* img;
           SDL_Color* col;
@@ -1449,8 +1451,8 @@ static void run_script(void)
           SDL_Flip(screen);
           
           /* Announce the lesson instruction */
-		  T4K_Tts_say(DEFAULT_VALUE,DEFAULT_VALUE,INTERRUPT,"%s",tts_buffer);
-		  tts_buffer[0] = '\0'; 
+		  T4K_Tts_say(DEFAULT_VALUE,DEFAULT_VALUE,INTERRUPT,"%S",wsb_str(&tts_buffer));
+		  wsb_reset(&tts_buffer); 
 
           while (!done)
           {
@@ -1519,8 +1521,8 @@ static void run_script(void)
           int done = 0;
           
           /* Announce the lesson instruction */
-		  T4K_Tts_say(DEFAULT_VALUE,DEFAULT_VALUE,INTERRUPT,"%s",tts_buffer);
-		  tts_buffer[0] = '\0';          
+		  T4K_Tts_say(DEFAULT_VALUE,DEFAULT_VALUE,INTERRUPT,"%S",wsb_str(&tts_buffer));
+		  wsb_reset(&tts_buffer);          
           
           
           // Make sure everything is on screen 
@@ -109,6 +109,7 @@ void GraphicsInit(void)
   }
 
   InitBlitQueue();
+  InitZoomThreads();
 
 
 
@@ -654,6 +655,8 @@ void Cleanup(void)
 {
   SDL_FreeSurface(screen);
   screen = NULL;
+  FreeBlitQueue();
+  FreeZoomThreads();
   Cleanup_SDL_Text();
   SDL_Quit();
 }